@@ -0,0 +1,59 @@
+#include "arena.h"
+
+#include <algorithm>
+
+#include "hugepage.h"
+
+namespace cpurt
+{
+	Arena::~Arena()
+	{
+		for (const auto &block : m_blocks)
+		{
+			hugepages::deallocate(block.data, block.size);
+		}
+	}
+
+	void Arena::reset()
+	{
+		while (m_blocks.size() > 1)
+		{
+			const auto &block = m_blocks.back();
+
+			m_reserved -= block.size;
+			hugepages::deallocate(block.data, block.size);
+
+			m_blocks.pop_back();
+		}
+
+		m_offset = 0;
+	}
+
+	void *Arena::allocBytes(std::size_t bytes, std::size_t alignment)
+	{
+		if (!m_blocks.empty())
+		{
+			const auto &block = m_blocks.back();
+			const auto offset = (m_offset + alignment - 1) / alignment * alignment;
+
+			if (offset + bytes <= block.size)
+			{
+				m_offset = offset + bytes;
+				return block.data + offset;
+			}
+		}
+
+		// oversized requests get a block of their own
+		const auto size = std::max(bytes, m_blockSize);
+
+		auto &block = m_blocks.emplace_back(Block {
+			.data = static_cast<u8 *>(hugepages::allocate(size)),
+			.size = size
+		});
+
+		m_reserved += size;
+		m_offset = bytes;
+
+		return block.data;
+	}
+}
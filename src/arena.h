@@ -0,0 +1,55 @@
+#pragma once
+
+#include "types.h"
+
+#include <cstddef>
+#include <vector>
+#include <span>
+#include <type_traits>
+
+namespace cpurt
+{
+	// bump allocator for short-lived build data, everything is freed at once.
+	// only for trivial types, nothing is constructed or destroyed
+	class Arena
+	{
+	public:
+		explicit Arena(std::size_t blockSize = DefaultBlockSize)
+			: m_blockSize{blockSize} {}
+
+		~Arena();
+
+		Arena(const Arena &) = delete;
+		Arena &operator=(const Arena &) = delete;
+
+		template <typename T>
+		[[nodiscard]] inline std::span<T> alloc(std::size_t count)
+		{
+			static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>);
+			return {static_cast<T *>(allocBytes(count * sizeof(T), alignof(T))), count};
+		}
+
+		// releases everything, keeping the first block for reuse
+		void reset();
+
+		[[nodiscard]] inline std::size_t bytesReserved() const { return m_reserved; }
+
+		static constexpr std::size_t DefaultBlockSize = 1024 * 1024;
+
+	private:
+		struct Block
+		{
+			u8 *data;
+			std::size_t size;
+		};
+
+		[[nodiscard]] void *allocBytes(std::size_t bytes, std::size_t alignment);
+
+		std::size_t m_blockSize;
+
+		std::vector<Block> m_blocks{};
+		std::size_t m_offset{};
+
+		std::size_t m_reserved{};
+	};
+}
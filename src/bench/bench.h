@@ -0,0 +1,47 @@
+#pragma once
+
+#include "../types.h"
+
+#include <string_view>
+#include <iostream>
+
+#include "../timer.h"
+
+namespace cpurt::bench
+{
+	template <typename T>
+	inline void doNotOptimize(const T &v)
+	{
+		asm volatile("" : : "r,m"(v) : "memory");
+	}
+
+	// runs func(iterations) once to warm up, then again timed; returns ns per iteration
+	template <typename F>
+	inline f64 measure(u32 iterations, F &&func)
+	{
+		func(iterations / 16 + 1);
+
+		Timer timer{};
+
+		const auto start = timer.time();
+		func(iterations);
+		const auto time = timer.time() - start;
+
+		return time * 1000000000.0 / static_cast<f64>(iterations);
+	}
+
+	inline void report(std::string_view name, f64 nsPerOp, f64 baseline = 0.0)
+	{
+		std::cout << "  " << name << ": " << nsPerOp << " ns/op";
+
+		if (baseline > 0.0)
+			std::cout << " (" << (baseline / nsPerOp) << "x)";
+
+		std::cout << std::endl;
+	}
+
+	void runRng();
+	void runScheduler();
+	void runOrder();
+	void runHugePages();
+}
@@ -0,0 +1,130 @@
+#include "bench.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "perf.h"
+#include "../scene.h"
+#include "../rng.h"
+#include "../hugepage.h"
+#include "../config.h"
+
+namespace cpurt::bench
+{
+	namespace
+	{
+		// ~200 MB of spheres and nodes, far beyond what the tlb covers with 4k pages
+		constexpr u32 SphereCount = 2000000;
+		constexpr u32 RayCount = 200000;
+
+		constexpr f32 Extent = 1000.0F;
+
+		// transparent huge pages currently backing this process, in kB
+		u64 anonHugePages()
+		{
+			std::ifstream stream{"/proc/self/smaps_rollup"};
+			std::string line{};
+
+			while (std::getline(stream, line))
+			{
+				if (line.starts_with("AnonHugePages:"))
+					return std::stoull(line.substr(14));
+			}
+
+			return 0;
+		}
+
+		void fillScene(Scene &scene)
+		{
+			Rng rng{0xB16B00B5};
+
+			const auto material = scene.createDiffuse({0.5F, 0.5F, 0.5F});
+
+			scene.reserve(SphereCount);
+
+			for (u32 i = 0; i < SphereCount; ++i)
+			{
+				scene.createSphere({
+					.pos = (glm::vec3{rng.nextF32(), rng.nextF32(), rng.nextF32()} - 0.5F) * Extent,
+					.radius = 0.1F + rng.nextF32() * 0.4F,
+					.materialId = material
+				});
+			}
+		}
+	}
+
+	void runHugePages()
+	{
+		PerfCounter tlbMisses{PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB
+			| (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+
+		if (!tlbMisses.valid())
+			std::cout << "  tlb counter unavailable (perf_event_paranoid?)" << std::endl;
+
+		std::cout << "  " << SphereCount << " spheres, " << RayCount << " rays" << std::endl;
+
+		f64 baseline = 0.0;
+		u64 baselineMisses = 0;
+
+		for (const auto enabled : {false, true})
+		{
+			hugepages::setEnabled(enabled);
+
+			Scene scene{};
+			fillScene(scene);
+
+			Timer timer{};
+			scene.buildBvh();
+			const auto buildTime = timer.time();
+
+			const auto hugeKb = anonHugePages();
+
+			Rng rng{0x1234};
+			TraceResult result{};
+			u32 hits = 0;
+
+			const auto startMisses = tlbMisses.read();
+
+			const auto nsPerRay = measure(RayCount, [&](u32 rays)
+			{
+				for (u32 i = 0; i < rays; ++i)
+				{
+					const Ray ray{
+						.origin = (glm::vec3{rng.nextF32(), rng.nextF32(), rng.nextF32()} - 0.5F) * Extent,
+						.dir = rng.nextUnit()
+					};
+
+					scene.traceRay(result, ray);
+					hits += result.hitMaterial != nullptr;
+				}
+			});
+
+			const auto misses = tlbMisses.read() - startMisses;
+
+			doNotOptimize(hits);
+
+			if (baseline == 0.0)
+			{
+				baseline = nsPerRay;
+				baselineMisses = misses;
+			}
+
+			std::cout << "  huge pages " << (enabled ? "on" : "off") << ": build " << (buildTime * 1000.0)
+				<< " ms, " << (hugeKb / 1024) << " MiB on huge pages, "
+				<< (1000.0 / nsPerRay) << " Mrays/s (" << (baseline / nsPerRay) << "x)";
+
+			if (tlbMisses.valid())
+			{
+				std::cout << ", " << misses << " dtlb misses";
+
+				if (enabled && misses > 0)
+					std::cout << " (" << (static_cast<f64>(baselineMisses) / static_cast<f64>(misses)) << "x fewer)";
+			}
+
+			std::cout << std::endl;
+		}
+
+		hugepages::setEnabled(HugePages);
+	}
+}
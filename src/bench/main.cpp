@@ -0,0 +1,64 @@
+#include <iostream>
+#include <string_view>
+#include <array>
+
+#include "../types.h"
+
+#include "bench.h"
+
+using namespace cpurt;
+
+namespace
+{
+	struct Benchmark
+	{
+		std::string_view name;
+		void (*func)();
+	};
+
+	constexpr auto Benchmarks = std::array {
+		Benchmark{"rng", bench::runRng},
+		Benchmark{"scheduler", bench::runScheduler},
+		Benchmark{"order", bench::runOrder},
+		Benchmark{"hugepages", bench::runHugePages}
+	};
+}
+
+int main(int argc, const char *argv[])
+{
+	bool ran = false;
+
+	for (const auto &benchmark : Benchmarks)
+	{
+		bool selected = argc < 2;
+
+		for (i32 i = 1; i < argc; ++i)
+		{
+			if (benchmark.name == argv[i])
+				selected = true;
+		}
+
+		if (!selected)
+			continue;
+
+		std::cout << benchmark.name << std::endl;
+		benchmark.func();
+
+		ran = true;
+	}
+
+	if (!ran)
+	{
+		std::cerr << "no matching benchmarks, available:";
+
+		for (const auto &benchmark : Benchmarks)
+		{
+			std::cerr << ' ' << benchmark.name;
+		}
+
+		std::cerr << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,119 @@
+#include "bench.h"
+
+#include <array>
+#include <string_view>
+
+#include "perf.h"
+#include "../scene.h"
+#include "../scenes.h"
+#include "../camera.h"
+#include "../render.h"
+#include "../framebuffer.h"
+
+namespace cpurt::bench
+{
+	namespace
+	{
+		constexpr u32 OrderWidth = 480;
+		constexpr u32 OrderHeight = 320;
+		constexpr u32 OrderSamples = 8;
+
+		struct TileOrderName
+		{
+			TileOrder order;
+			std::string_view name;
+		};
+
+		struct PixelOrderName
+		{
+			PixelOrder order;
+			std::string_view name;
+		};
+
+		constexpr auto TileOrders = std::array {
+			TileOrderName{TileOrder::RowMajor, "row"},
+			TileOrderName{TileOrder::Morton, "morton"},
+			TileOrderName{TileOrder::Hilbert, "hilbert"},
+			TileOrderName{TileOrder::Cost, "cost"}
+		};
+
+		constexpr auto PixelOrders = std::array {
+			PixelOrderName{PixelOrder::RowMajor, "row"},
+			PixelOrderName{PixelOrder::Morton, "morton"}
+		};
+	}
+
+	void runOrder()
+	{
+		// opened before any renderer so its worker threads are counted too
+		PerfCounter references{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES};
+		PerfCounter misses{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES};
+
+		const bool counters = references.valid() && misses.valid();
+
+		if (!counters)
+			std::cout << "  cache counters unavailable (perf_event_paranoid?)" << std::endl;
+
+		Scene scene{};
+		initRandomScene(scene);
+		scene.buildBvh();
+
+		Camera camera{OrderWidth, OrderHeight, 20.0F, 0.1F, 10.0F};
+
+		camera.pos() = {13.0F, 2.0F, 3.0F};
+		camera.target() = {0.0F, 0.0F, 0.0F};
+
+		camera.update();
+
+		// one pass, so every order does the same work
+		const ProgressiveSettings settings{
+			.totalSamples = OrderSamples,
+			.passSamples = OrderSamples,
+			.snapshotInterval = 0.0
+		};
+
+		Renderer renderer{};
+
+		constexpr auto Paths = static_cast<f64>(OrderWidth * OrderHeight * OrderSamples);
+
+		f64 baseline = 0.0;
+
+		for (const auto &tileOrder : TileOrders)
+		{
+			for (const auto &pixelOrder : PixelOrders)
+			{
+				renderer.tileOrder(tileOrder.order);
+				renderer.pixelOrder(pixelOrder.order);
+
+				Framebuffer framebuffer{OrderWidth, OrderHeight, 0x1234};
+
+				const auto startReferences = references.read();
+				const auto startMisses = misses.read();
+
+				Timer timer{};
+				renderer.drawProgressive(scene, camera, framebuffer, settings, {});
+				const auto time = timer.time();
+
+				const auto nsPerPath = time * 1000000000.0 / Paths;
+
+				if (baseline == 0.0)
+					baseline = nsPerPath;
+
+				std::cout << "  tiles " << tileOrder.name << ", pixels " << pixelOrder.name << ": "
+					<< (Paths / time / 1000000.0) << " Mpaths/s (" << (baseline / nsPerPath) << "x)";
+
+				if (counters)
+				{
+					const auto refs = references.read() - startReferences;
+					const auto missed = misses.read() - startMisses;
+
+					std::cout << ", " << refs << " llc refs, " << missed << " misses ("
+						<< (refs == 0 ? 0.0 : 100.0 * static_cast<f64>(refs - missed) / static_cast<f64>(refs))
+						<< "% hit)";
+				}
+
+				std::cout << std::endl;
+			}
+		}
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../types.h"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace cpurt::bench
+{
+	// a hardware counter for this process, including threads started after it was opened
+	class PerfCounter
+	{
+	public:
+		PerfCounter(u32 type, u64 config)
+		{
+			perf_event_attr attr{};
+
+			attr.size = sizeof(perf_event_attr);
+			attr.type = type;
+			attr.config = config;
+			attr.disabled = 1;
+			attr.inherit = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+
+			m_fd = static_cast<i32>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+
+			if (m_fd >= 0)
+				ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+
+		~PerfCounter()
+		{
+			if (m_fd >= 0)
+				close(m_fd);
+		}
+
+		PerfCounter(const PerfCounter &) = delete;
+		PerfCounter &operator=(const PerfCounter &) = delete;
+
+		[[nodiscard]] inline bool valid() const { return m_fd >= 0; }
+
+		// running total, exited threads included
+		[[nodiscard]] inline u64 read() const
+		{
+			u64 value{};
+
+			if (m_fd < 0 || ::read(m_fd, &value, sizeof(value)) != sizeof(value))
+				return 0;
+
+			return value;
+		}
+
+	private:
+		i32 m_fd{-1};
+	};
+}
@@ -0,0 +1,226 @@
+#include "bench.h"
+
+#include <vector>
+
+#include <glm/gtx/norm.hpp>
+
+#include "../rng.h"
+#include "../sampling.h"
+#include "../vecrng.h"
+
+namespace cpurt::bench
+{
+	namespace
+	{
+		constexpr u32 Iterations = 1 << 24;
+
+		// the old rejection/normalisation based samplers, for comparison
+		namespace legacy
+		{
+			inline glm::vec3 nextVector(Rng &rng)
+			{
+				return glm::vec3{rng.nextF32() - 0.5F, rng.nextF32() - 0.5F, rng.nextF32() - 0.5F};
+			}
+
+			inline glm::vec3 nextUnitOrLess(Rng &rng)
+			{
+				while (true)
+				{
+					const auto candidate = nextVector(rng);
+					if (glm::length2(candidate) <= 1.0F)
+						return candidate;
+				}
+			}
+
+			inline glm::vec3 nextUnit(Rng &rng)
+			{
+				return glm::normalize(nextVector(rng));
+			}
+
+			inline glm::vec2 nextInUnitDisk(Rng &rng)
+			{
+				while (true)
+				{
+					const glm::vec2 candidate{rng.nextF32() * 2.0F - 1.0F, rng.nextF32() * 2.0F - 1.0F};
+					if (glm::length2(candidate) < 1.0F)
+						return candidate;
+				}
+			}
+		}
+
+		template <typename F>
+		f64 measureScalar(F &&sample)
+		{
+			return measure(Iterations, [&](u32 n)
+			{
+				Rng rng{0x12345678};
+
+				for (u32 i = 0; i < n; ++i)
+				{
+					doNotOptimize(sample(rng));
+				}
+			});
+		}
+
+		// variates are pregenerated so only the mapping itself is measured
+		template <u32 Dims, typename F>
+		f64 measureX8(F &&sample)
+		{
+			constexpr u32 Batch = 4096;
+
+			std::vector<simd::f32x8> inputs(Batch * Dims);
+
+			Rng rng{0x12345678};
+
+			for (auto &v : inputs)
+			{
+				for (u32 lane = 0; lane < 8; ++lane)
+				{
+					v[lane] = rng.nextF32();
+				}
+			}
+
+			const auto perSample = measure(Iterations / 8, [&](u32 n)
+			{
+				for (u32 i = 0; i < n; ++i)
+				{
+					doNotOptimize(sample(&inputs[(i % Batch) * Dims]));
+				}
+			});
+
+			return perSample / 8.0;
+		}
+
+		template <u32 Dims, typename F>
+		f64 measureScalarMapping(F &&sample)
+		{
+			constexpr u32 Batch = 4096;
+
+			std::vector<f32> inputs(Batch * Dims);
+
+			Rng rng{0x12345678};
+
+			for (auto &v : inputs)
+			{
+				v = rng.nextF32();
+			}
+
+			return measure(Iterations, [&](u32 n)
+			{
+				for (u32 i = 0; i < n; ++i)
+				{
+					doNotOptimize(sample(&inputs[(i % Batch) * Dims]));
+				}
+			});
+		}
+	}
+
+	void runRng()
+	{
+		{
+			constexpr u32 Count = 1 << 16;
+
+			std::vector<f32> buffer(Count);
+
+			Rng rng{0x12345678};
+			const auto scalar = measure(Iterations / Count, [&](u32 n)
+			{
+				for (u32 i = 0; i < n; ++i)
+				{
+					for (auto &v : buffer)
+					{
+						v = rng.nextF32();
+					}
+
+					doNotOptimize(buffer.data());
+				}
+			}) / Count;
+			report("f32 fill (scalar)", scalar);
+
+			RngX8 rngX8{0x12345678};
+			report("f32 fill (x8)", measure(Iterations / Count, [&](u32 n)
+			{
+				for (u32 i = 0; i < n; ++i)
+				{
+					rngX8.fillF32(buffer);
+					doNotOptimize(buffer.data());
+				}
+			}) / Count, scalar);
+
+			RngX16 rngX16{0x12345678};
+			report("f32 fill (x16)", measure(Iterations / Count, [&](u32 n)
+			{
+				for (u32 i = 0; i < n; ++i)
+				{
+					rngX16.fillF32(buffer);
+					doNotOptimize(buffer.data());
+				}
+			}) / Count, scalar);
+
+			// a fresh stream every 8 numbers, as for a short path
+			report("f32 fill (counter-based)", measure(Iterations / Count, [&](u32 n)
+			{
+				for (u32 i = 0; i < n; ++i)
+				{
+					for (u32 sample = 0; sample < Count / 8; ++sample)
+					{
+						SampleRng sampleRng{0x12345678, i, sample};
+
+						for (u32 dim = 0; dim < 8; ++dim)
+						{
+							buffer[sample * 8 + dim] = sampleRng.nextF32();
+						}
+					}
+
+					doNotOptimize(buffer.data());
+				}
+			}) / Count, scalar);
+		}
+
+		{
+			const auto legacy = measureScalar([](Rng &rng) { return legacy::nextInUnitDisk(rng); });
+			report("disk (rejection)", legacy);
+			report("disk (concentric)", measureScalar([](Rng &rng) { return rng.nextInUnitDisk(); }), legacy);
+
+			const auto baseline = measureScalarMapping<2>([](const f32 *in)
+			{
+				glm::vec2 v;
+				sampling::concentricDisk(in[0], in[1], v.x, v.y);
+				return v;
+			});
+			report("disk mapping only", baseline);
+			report("disk mapping only x8", measureX8<2>([](const simd::f32x8 *in)
+			{
+				simd::f32x8 x, y;
+				sampling::concentricDisk(in[0], in[1], x, y);
+				return x + y;
+			}), baseline);
+		}
+
+		{
+			const auto legacy = measureScalar([](Rng &rng) { return legacy::nextUnit(rng); });
+			report("sphere (normalised cube)", legacy);
+			report("sphere (closed form)", measureScalar([](Rng &rng) { return rng.nextUnit(); }), legacy);
+
+			const auto baseline = measureScalarMapping<2>([](const f32 *in)
+			{
+				glm::vec3 v;
+				sampling::uniformSphere(in[0], in[1], v.x, v.y, v.z);
+				return v;
+			});
+			report("sphere mapping only", baseline);
+			report("sphere mapping only x8", measureX8<2>([](const simd::f32x8 *in)
+			{
+				simd::f32x8 x, y, z;
+				sampling::uniformSphere(in[0], in[1], x, y, z);
+				return x + y + z;
+			}), baseline);
+		}
+
+		{
+			const auto legacy = measureScalar([](Rng &rng) { return legacy::nextUnitOrLess(rng); });
+			report("ball (rejection)", legacy);
+			report("ball (closed form)", measureScalar([](Rng &rng) { return rng.nextUnitOrLess(); }), legacy);
+		}
+	}
+}
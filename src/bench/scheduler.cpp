@@ -0,0 +1,135 @@
+#include "bench.h"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "../queue.h"
+#include "../scheduler.h"
+
+namespace cpurt::bench
+{
+	namespace
+	{
+		constexpr u32 Batches = 64;
+		constexpr u32 TasksPerBatch = 4096;
+
+		// stand-in for a small tile
+		inline void work(u32 task, u32 spin)
+		{
+			auto v = task;
+
+			for (u32 i = 0; i < spin; ++i)
+			{
+				v = v * 1664525 + 1013904223;
+			}
+
+			doNotOptimize(v);
+		}
+
+		// the renderer's original dispatch: one mutex-protected queue,
+		// and a mutex + notify_all per finished task
+		class QueuePool
+		{
+		public:
+			explicit QueuePool(u32 threadCount)
+			{
+				for (u32 i = 0; i < threadCount; ++i)
+				{
+					m_threads.emplace_back([this]
+					{
+						while (true)
+						{
+							const auto task = m_queue.wait();
+
+							if (task == Exit)
+								break;
+
+							work(task, m_spin);
+
+							{
+								std::scoped_lock lock{m_mutex};
+								--m_counter;
+								m_signal.notify_all();
+							}
+						}
+					});
+				}
+			}
+
+			~QueuePool()
+			{
+				// one exit per thread
+				for (std::size_t i = 0; i < m_threads.size(); ++i)
+				{
+					m_queue.push(Exit);
+				}
+
+				for (auto &thread : m_threads)
+				{
+					thread.join();
+				}
+			}
+
+			void run(u32 count, u32 spin)
+			{
+				m_spin = spin;
+				m_counter.store(count);
+
+				for (u32 i = 0; i < count; ++i)
+				{
+					m_queue.push(i);
+				}
+
+				std::unique_lock lock{m_mutex};
+				m_signal.wait(lock, [this] { return m_counter.load() == 0; });
+			}
+
+		private:
+			static constexpr u32 Exit = ~0U;
+
+			BlockingQueue<u32> m_queue{};
+			std::vector<std::thread> m_threads{};
+
+			std::mutex m_mutex{};
+			std::condition_variable m_signal{};
+			std::atomic<u32> m_counter{};
+
+			u32 m_spin{};
+		};
+	}
+
+	void runScheduler()
+	{
+		const auto threadCount = std::thread::hardware_concurrency();
+
+		std::cout << "  " << threadCount << " threads, " << TasksPerBatch << " tasks per batch" << std::endl;
+
+		QueuePool queue{threadCount};
+		Scheduler scheduler{threadCount};
+
+		for (const u32 spin : {0U, 256U, 4096U})
+		{
+			std::cout << "  " << spin << " iterations per task" << std::endl;
+
+			const auto baseline = measure(Batches, [&](u32 n)
+			{
+				for (u32 i = 0; i < n; ++i)
+				{
+					queue.run(TasksPerBatch, spin);
+				}
+			}) / TasksPerBatch;
+			report("blocking queue", baseline);
+
+			report("work stealing", measure(Batches, [&](u32 n)
+			{
+				for (u32 i = 0; i < n; ++i)
+				{
+					scheduler.run(TasksPerBatch, [spin](u32 task) { work(task, spin); });
+				}
+			}) / TasksPerBatch, baseline);
+		}
+	}
+}
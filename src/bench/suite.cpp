@@ -0,0 +1,325 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <limits>
+
+#include "../types.h"
+#include "../config.h"
+#include "../scene.h"
+#include "../scenes.h"
+#include "../camera.h"
+#include "../render.h"
+#include "../framebuffer.h"
+#include "../simd.h"
+#include "../timer.h"
+#include "../parse.h"
+
+// end-to-end renders of a fixed set of scenes, at fixed seeds and settings, so the
+// numbers can be compared between builds and machines. prints a summary, and
+// with --json writes every result for regression tracking
+using namespace cpurt;
+
+namespace
+{
+	constexpr u32 SuiteWidth = 400;
+	constexpr u32 SuiteHeight = 225;
+	constexpr u32 SuiteSamples = 8;
+
+	// the best of these many renders is reported
+	constexpr u32 DefaultRuns = 3;
+
+	constexpr u32 FramebufferSeed = 0x5EED;
+	constexpr u32 SceneSeed = 0x696969;
+
+	enum class SceneKind : u32
+	{
+		Test = 0,
+		Random,
+		Scaled
+	};
+
+	struct SuiteScene
+	{
+		std::string_view name;
+		SceneKind kind;
+
+		// for scaled scenes
+		u32 spheres;
+	};
+
+	constexpr auto Scenes = std::array {
+		SuiteScene{"test", SceneKind::Test, 0},
+		SuiteScene{"random", SceneKind::Random, 0},
+		SuiteScene{"scaled-1k", SceneKind::Scaled, 1'000},
+		SuiteScene{"scaled-10k", SceneKind::Scaled, 10'000},
+		SuiteScene{"scaled-100k", SceneKind::Scaled, 100'000},
+		SuiteScene{"scaled-1m", SceneKind::Scaled, 1'000'000},
+		SuiteScene{"scaled-10m", SceneKind::Scaled, 10'000'000}
+	};
+
+	struct Result
+	{
+		std::string_view name;
+		u32 spheres;
+
+		f64 buildTime; // seconds
+		std::size_t bvhBytes, sphereBytes;
+
+		f64 renderTime; // seconds, best run
+		u64 primaryRays, rays;
+	};
+
+	struct SuiteOptions
+	{
+		std::vector<std::string_view> scenes{};
+
+		std::string json{};
+
+		u32 runs{DefaultRuns};
+		u32 maxSpheres{std::numeric_limits<u32>::max()};
+	};
+
+	bool parseOptions(i32 argc, const char *argv[], SuiteOptions &options)
+	{
+		for (i32 i = 1; i < argc; ++i)
+		{
+			const std::string_view arg{argv[i]};
+
+			const bool hasValue = i + 1 < argc;
+
+			if (arg == "--json" && hasValue)
+				options.json = argv[++i];
+			else if (arg == "--runs" && hasValue)
+			{
+				if (!parseNumber(std::string_view{argv[++i]}, options.runs) || options.runs == 0)
+				{
+					std::cerr << "invalid run count " << argv[i] << std::endl;
+					return false;
+				}
+			}
+			else if (arg == "--max-spheres" && hasValue)
+			{
+				if (!parseNumber(std::string_view{argv[++i]}, options.maxSpheres))
+				{
+					std::cerr << "invalid sphere count " << argv[i] << std::endl;
+					return false;
+				}
+			}
+			else if (arg.starts_with("--"))
+			{
+				std::cerr << "usage: " << argv[0] << " [--json <file>] [--runs <n>] [--max-spheres <n>] [scene...]\n"
+					<< "scenes:";
+
+				for (const auto &scene : Scenes)
+				{
+					std::cerr << ' ' << scene.name;
+				}
+
+				std::cerr << std::endl;
+				return false;
+			}
+			else if (std::none_of(Scenes.begin(), Scenes.end(), [arg](const SuiteScene &scene) { return scene.name == arg; }))
+			{
+				std::cerr << "unknown scene " << arg << std::endl;
+				return false;
+			}
+			else options.scenes.push_back(arg);
+		}
+
+		return true;
+	}
+
+	void initScene(const SuiteScene &suiteScene, Scene &scene, Camera &camera)
+	{
+		switch (suiteScene.kind)
+		{
+		case SceneKind::Test:
+			{
+				const auto center = initTestScene(scene);
+
+				camera = Camera{SuiteWidth, SuiteHeight, 90.0F, 0.001F, 1.0F};
+
+				camera.pos() = {0.0F, 0.0F, 2.0F};
+				camera.target() = scene.sphere(center).pos;
+			}
+			break;
+
+		case SceneKind::Random:
+		case SceneKind::Scaled:
+			if (suiteScene.kind == SceneKind::Random)
+				initRandomScene(scene);
+			else initScaledScene(scene, suiteScene.spheres, SceneSeed);
+
+			camera = Camera{SuiteWidth, SuiteHeight, 20.0F, 0.1F, 10.0F};
+
+			camera.pos() = {13.0F, 2.0F, 3.0F};
+			camera.target() = {0.0F, 0.0F, 0.0F};
+			break;
+		}
+
+		camera.update();
+	}
+
+	Result run(Renderer &renderer, const SuiteScene &suiteScene, u32 runs)
+	{
+		Scene scene{};
+		Camera camera{SuiteWidth, SuiteHeight, 20.0F, 0.1F, 10.0F};
+
+		initScene(suiteScene, scene, camera);
+
+		Result result{
+			.name = suiteScene.name,
+			.spheres = scene.sphereCount()
+		};
+
+		Timer buildTimer{};
+		scene.buildBvh();
+		result.buildTime = buildTimer.time();
+
+		result.bvhBytes = scene.bvhBytes();
+		result.sphereBytes = scene.sphereBytes();
+
+		// one pass, so every run does exactly the same work
+		const ProgressiveSettings settings{
+			.totalSamples = SuiteSamples,
+			.passSamples = SuiteSamples,
+			.snapshotInterval = 0.0
+		};
+
+		result.renderTime = std::numeric_limits<f64>::infinity();
+		result.primaryRays = static_cast<u64>(SuiteWidth) * SuiteHeight * SuiteSamples;
+
+		for (u32 i = 0; i < runs; ++i)
+		{
+			Framebuffer framebuffer{SuiteWidth, SuiteHeight, FramebufferSeed};
+
+			const auto startRays = renderer.raysTraced();
+
+			Timer timer{};
+			renderer.drawProgressive(scene, camera, framebuffer, settings, {});
+			const auto time = timer.time();
+
+			// the same every run, the seeds are fixed
+			result.rays = renderer.raysTraced() - startRays;
+			result.renderTime = std::min(result.renderTime, time);
+		}
+
+		return result;
+	}
+
+	void printSummary(const std::vector<Result> &results)
+	{
+		const auto flags = std::cout.flags();
+		const auto precision = std::cout.precision();
+
+		std::cout << '\n' << std::left << std::setw(14) << "scene" << std::right
+			<< std::setw(10) << "spheres" << std::setw(12) << "build ms" << std::setw(12) << "bvh MiB"
+			<< std::setw(12) << "render ms" << std::setw(16) << "primary Mray/s" << std::setw(10) << "Mray/s" << '\n';
+
+		std::cout << std::fixed;
+
+		for (const auto &result : results)
+		{
+			std::cout << std::left << std::setw(14) << result.name << std::right
+				<< std::setw(10) << result.spheres
+				<< std::setprecision(1) << std::setw(12) << (result.buildTime * 1000.0)
+				<< std::setprecision(2) << std::setw(12) << (static_cast<f64>(result.bvhBytes) / 1024.0 / 1024.0)
+				<< std::setprecision(1) << std::setw(12) << (result.renderTime * 1000.0)
+				<< std::setprecision(3) << std::setw(16) << (static_cast<f64>(result.primaryRays) / result.renderTime / 1e6)
+				<< std::setw(10) << (static_cast<f64>(result.rays) / result.renderTime / 1e6) << '\n';
+		}
+
+		std::cout.flags(flags);
+		std::cout.precision(precision);
+		std::cout << std::flush;
+	}
+
+	bool writeJson(const std::string &filename, const std::vector<Result> &results, u32 threads, u32 runs)
+	{
+		std::ofstream out{filename};
+
+		if (!out)
+		{
+			std::cerr << "failed to open " << filename << std::endl;
+			return false;
+		}
+
+		out << "{\n"
+			<< "  \"kernels\": \"" << simd::kernelIsa() << "\",\n"
+			<< "  \"threads\": " << threads << ",\n"
+			<< "  \"width\": " << SuiteWidth << ",\n"
+			<< "  \"height\": " << SuiteHeight << ",\n"
+			<< "  \"samples\": " << SuiteSamples << ",\n"
+			<< "  \"bounces\": " << Bounces << ",\n"
+			<< "  \"runs\": " << runs << ",\n"
+			<< "  \"scenes\": [";
+
+		for (std::size_t i = 0; i < results.size(); ++i)
+		{
+			const auto &result = results[i];
+
+			out << (i == 0 ? "\n" : ",\n")
+				<< "    {\n"
+				<< "      \"name\": \"" << result.name << "\",\n"
+				<< "      \"spheres\": " << result.spheres << ",\n"
+				<< "      \"bvh_build_ms\": " << (result.buildTime * 1000.0) << ",\n"
+				<< "      \"bvh_bytes\": " << result.bvhBytes << ",\n"
+				<< "      \"sphere_bytes\": " << result.sphereBytes << ",\n"
+				<< "      \"render_ms\": " << (result.renderTime * 1000.0) << ",\n"
+				<< "      \"primary_rays\": " << result.primaryRays << ",\n"
+				<< "      \"rays\": " << result.rays << ",\n"
+				<< "      \"primary_mrays_per_sec\": " << (static_cast<f64>(result.primaryRays) / result.renderTime / 1e6) << ",\n"
+				<< "      \"mrays_per_sec\": " << (static_cast<f64>(result.rays) / result.renderTime / 1e6) << "\n"
+				<< "    }";
+		}
+
+		out << "\n  ]\n}\n";
+
+		if (!out)
+		{
+			std::cerr << "failed to write to " << filename << std::endl;
+			return false;
+		}
+
+		std::cout << "wrote results to " << filename << std::endl;
+		return true;
+	}
+}
+
+int main(int argc, const char *argv[])
+{
+	SuiteOptions options{};
+
+	if (!parseOptions(argc, argv, options))
+		return 1;
+
+	Renderer renderer{"suite"};
+
+	std::vector<Result> results{};
+
+	for (const auto &scene : Scenes)
+	{
+		if (!options.scenes.empty()
+			&& std::find(options.scenes.begin(), options.scenes.end(), scene.name) == options.scenes.end())
+			continue;
+
+		if (scene.kind == SceneKind::Scaled && scene.spheres > options.maxSpheres)
+			continue;
+
+		std::cout << scene.name << std::endl;
+
+		results.push_back(run(renderer, scene, options.runs));
+	}
+
+	printSummary(results);
+
+	if (!options.json.empty() && !writeJson(options.json, results, renderer.scheduler().threadCount(), options.runs))
+		return 1;
+
+	return 0;
+}
@@ -24,6 +24,9 @@ namespace cpurt
 		inline void fovY(f32 fovY) { m_fovY = fovY; }
 		[[nodiscard]] inline auto fovY() const { return m_fovY; }
 
+		[[nodiscard]] inline auto aperture() const { return m_aperture; }
+		[[nodiscard]] inline auto focalLength() const { return m_focalLength; }
+
 		[[nodiscard]] inline auto &pos() { return m_pos; }
 		[[nodiscard]] inline const auto &pos() const { return m_pos; }
 
@@ -32,7 +35,8 @@ namespace cpurt
 
 		void update();
 
-		[[nodiscard]] inline Ray ray(Rng &rng, u32 x, u32 y) const
+		template <typename Source>
+		[[nodiscard]] inline Ray ray(RandomSource<Source> &rng, u32 x, u32 y) const
 		{
 			const auto origin = m_lensRadius * rng.nextInUnitDisk();
 			const auto offset = m_u * origin.x + m_v * origin.y;
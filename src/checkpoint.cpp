@@ -0,0 +1,164 @@
+#include "checkpoint.h"
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <array>
+#include <filesystem>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace cpurt
+{
+	namespace
+	{
+		constexpr std::array<char, 8> Magic{'C', 'P', 'U', 'R', 'T', 'C', 'K', 'P'};
+		constexpr u32 Version = 1;
+
+		struct Header
+		{
+			std::array<char, 8> magic;
+			u32 version;
+			u32 width, height;
+			u32 seed;
+			u32 hasFeatures;
+		};
+
+		// what each pixel takes up after the header: color and sample count, then the features
+		constexpr std::size_t PixelBytes = sizeof(glm::vec3) + sizeof(u32)
+			+ (Denoise ? sizeof(glm::vec3) * 2 + sizeof(f32) : 0);
+
+		template <typename T>
+		bool writeVector(std::FILE *file, const std::vector<T> &v)
+		{
+			return std::fwrite(v.data(), sizeof(T), v.size(), file) == v.size();
+		}
+
+		template <typename T>
+		bool readVector(std::FILE *file, std::vector<T> &v)
+		{
+			return std::fread(v.data(), sizeof(T), v.size(), file) == v.size();
+		}
+	}
+
+	bool writeCheckpoint(const std::string &filename, const Framebuffer &framebuffer)
+	{
+		const auto tempFilename = filename + ".tmp";
+
+		auto *file = std::fopen(tempFilename.c_str(), "wb");
+
+		if (!file)
+		{
+			std::cerr << "failed to open " << tempFilename << std::endl;
+			return false;
+		}
+
+		const Header header {
+			.magic = Magic,
+			.version = Version,
+			.width = framebuffer.width,
+			.height = framebuffer.height,
+			.seed = framebuffer.seed,
+			.hasFeatures = Denoise ? 1U : 0U
+		};
+
+		bool success = std::fwrite(&header, sizeof(Header), 1, file) == 1
+			&& writeVector(file, framebuffer.color)
+			&& writeVector(file, framebuffer.samples);
+
+		if (success && Denoise)
+			success = writeVector(file, framebuffer.features.albedo)
+				&& writeVector(file, framebuffer.features.normal)
+				&& writeVector(file, framebuffer.features.depth);
+
+		success = std::fflush(file) == 0 && success;
+
+#ifndef _WIN32
+		// make sure the data is on disk before it replaces the previous checkpoint
+		success = fsync(fileno(file)) == 0 && success;
+#endif
+
+		success = std::fclose(file) == 0 && success;
+
+		if (!success)
+		{
+			std::cerr << "failed to write checkpoint to " << tempFilename << std::endl;
+			std::remove(tempFilename.c_str());
+			return false;
+		}
+
+		std::error_code error{};
+		std::filesystem::rename(tempFilename, filename, error);
+
+		if (error)
+		{
+			std::cerr << "failed to rename " << tempFilename << " to " << filename
+				<< ": " << error.message() << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	bool readCheckpoint(const std::string &filename, Framebuffer &framebuffer)
+	{
+		auto *file = std::fopen(filename.c_str(), "rb");
+
+		if (!file)
+		{
+			std::cerr << "failed to open " << filename << std::endl;
+			return false;
+		}
+
+		Header header{};
+
+		if (std::fread(&header, sizeof(Header), 1, file) != 1
+			|| header.magic != Magic || header.version != Version)
+		{
+			std::cerr << filename << " is not a valid checkpoint" << std::endl;
+			std::fclose(file);
+			return false;
+		}
+
+		if ((header.hasFeatures != 0) != Denoise)
+		{
+			std::cerr << filename << " was written with denoising "
+				<< (Denoise ? "disabled" : "enabled") << std::endl;
+			std::fclose(file);
+			return false;
+		}
+
+		// the dimensions have to match the file's size before they get allocated
+		std::error_code error{};
+		const auto fileSize = std::filesystem::file_size(filename, error);
+
+		const auto pixels = static_cast<u64>(header.width) * header.height;
+
+		if (error || fileSize < sizeof(Header) || (fileSize - sizeof(Header)) % PixelBytes != 0
+			|| (fileSize - sizeof(Header)) / PixelBytes != pixels)
+		{
+			std::cerr << filename << " is truncated or has invalid dimensions" << std::endl;
+			std::fclose(file);
+			return false;
+		}
+
+		framebuffer = Framebuffer{header.width, header.height, header.seed};
+
+		bool success = readVector(file, framebuffer.color)
+			&& readVector(file, framebuffer.samples);
+
+		if (success && Denoise)
+			success = readVector(file, framebuffer.features.albedo)
+				&& readVector(file, framebuffer.features.normal)
+				&& readVector(file, framebuffer.features.depth);
+
+		std::fclose(file);
+
+		if (!success)
+			std::cerr << "unexpected end of file in " << filename << std::endl;
+
+		return success;
+	}
+}
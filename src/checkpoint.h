@@ -0,0 +1,16 @@
+#pragma once
+
+#include "types.h"
+
+#include <string>
+
+#include "framebuffer.h"
+
+namespace cpurt
+{
+	// the complete accumulation state (sums, sample counts, guide features and
+	// seed) - resuming from it produces the same image as an uninterrupted render.
+	// written to a temporary file, synced, then renamed over the previous checkpoint
+	bool writeCheckpoint(const std::string &filename, const Framebuffer &framebuffer);
+	bool readCheckpoint(const std::string &filename, Framebuffer &framebuffer);
+}
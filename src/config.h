@@ -13,5 +13,17 @@ namespace cpurt
 	constexpr u32 Threads = 0; // 0 for core count
 	constexpr u32 TileSize = 16;
 
+	// pin each worker to a cpu, and give each numa node its own copy of the scene
+	constexpr bool PinThreads = false;
+	constexpr bool ReplicateScene = true;
+
+	// back large scene arrays with 2 MiB pages where the os allows it
+	constexpr bool HugePages = true;
+
 	constexpr f32 Gamma = 2.2F;
+
+	// a-trous filter over the finished image, guided by first-hit albedo/normal/depth
+	// intended for low sample counts (16-32 spp)
+	constexpr bool Denoise = false;
+	constexpr u32 DenoisePasses = 5;
 }
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "types.h"
+
+namespace cpurt::curves
+{
+	namespace detail
+	{
+		// spreads the low 16 bits of v out to the even bits
+		constexpr u32 part1By1(u32 v)
+		{
+			v &= 0x0000FFFF;
+			v = (v | (v << 8)) & 0x00FF00FF;
+			v = (v | (v << 4)) & 0x0F0F0F0F;
+			v = (v | (v << 2)) & 0x33333333;
+			v = (v | (v << 1)) & 0x55555555;
+			return v;
+		}
+
+		constexpr u32 compact1By1(u32 v)
+		{
+			v &= 0x55555555;
+			v = (v | (v >> 1)) & 0x33333333;
+			v = (v | (v >> 2)) & 0x0F0F0F0F;
+			v = (v | (v >> 4)) & 0x00FF00FF;
+			v = (v | (v >> 8)) & 0x0000FFFF;
+			return v;
+		}
+	}
+
+	// z-order index of (x, y), for x and y < 65536
+	[[nodiscard]] constexpr u32 morton(u32 x, u32 y)
+	{
+		return detail::part1By1(x) | (detail::part1By1(y) << 1);
+	}
+
+	constexpr void mortonDecode(u32 code, u32 &x, u32 &y)
+	{
+		x = detail::compact1By1(code);
+		y = detail::compact1By1(code >> 1);
+	}
+
+	// distance of (x, y) along the hilbert curve filling an n * n grid, n a power of two
+	[[nodiscard]] constexpr u32 hilbert(u32 n, u32 x, u32 y)
+	{
+		u32 d = 0;
+
+		for (auto s = n / 2; s > 0; s /= 2)
+		{
+			const u32 rx = (x & s) > 0;
+			const u32 ry = (y & s) > 0;
+
+			d += s * s * ((3 * rx) ^ ry);
+
+			// rotate the quadrant
+			if (ry == 0)
+			{
+				if (rx == 1)
+				{
+					x = n - 1 - x;
+					y = n - 1 - y;
+				}
+
+				const auto t = x;
+				x = y;
+				y = t;
+			}
+		}
+
+		return d;
+	}
+}
@@ -0,0 +1,335 @@
+#include "deflate.h"
+
+#include <array>
+#include <algorithm>
+#include <bit>
+
+namespace cpurt::deflate
+{
+	namespace
+	{
+		constexpr u32 WindowSize = 32768;
+		constexpr u32 HashBits = 15;
+
+		// candidates looked at per position, more finds longer matches but takes longer
+		constexpr u32 MaxChain = 32;
+
+		constexpr u32 MinMatch = 3;
+		constexpr u32 MaxMatch = 258;
+
+		constexpr u32 EndOfBlock = 256;
+
+		constexpr u32 AdlerModulus = 65521;
+
+		constexpr std::array<u16, 29> LengthBase{
+			3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+			35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+		};
+
+		constexpr std::array<u8, 29> LengthExtra{
+			0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+			3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+		};
+
+		constexpr std::array<u16, 30> DistanceBase{
+			1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+			257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+		};
+
+		struct Code
+		{
+			u16 bits;
+			u16 length;
+		};
+
+		// huffman codes are defined msb first, but everything else is written lsb first
+		constexpr u32 reverse(u32 code, u32 length)
+		{
+			u32 result = 0;
+
+			for (u32 i = 0; i < length; ++i)
+			{
+				result = (result << 1) | ((code >> i) & 1);
+			}
+
+			return result;
+		}
+
+		// the fixed literal/length code from rfc 1951, 3.2.6
+		constexpr auto LiteralCodes = []
+		{
+			std::array<Code, 288> codes{};
+
+			for (u32 symbol = 0; symbol < 288; ++symbol)
+			{
+				u32 code, length;
+
+				if (symbol < 144)
+					code = 0x30 + symbol, length = 8;
+				else if (symbol < 256)
+					code = 0x190 + (symbol - 144), length = 9;
+				else if (symbol < 280)
+					code = symbol - 256, length = 7;
+				else code = 0xC0 + (symbol - 280), length = 8;
+
+				codes[symbol] = {static_cast<u16>(reverse(code, length)), static_cast<u16>(length)};
+			}
+
+			return codes;
+		}();
+
+		// index into LengthBase for each match length
+		constexpr auto LengthCodes = []
+		{
+			std::array<u8, MaxMatch + 1> codes{};
+
+			for (u32 code = 0; code < LengthBase.size(); ++code)
+			{
+				const auto end = code + 1 < LengthBase.size() ? LengthBase[code + 1] : MaxMatch + 1;
+
+				for (u32 length = LengthBase[code]; length < end; ++length)
+				{
+					codes[length] = static_cast<u8>(code);
+				}
+			}
+
+			return codes;
+		}();
+
+		constexpr auto CrcTable = []
+		{
+			std::array<u32, 256> table{};
+
+			for (u32 i = 0; i < 256; ++i)
+			{
+				auto c = i;
+
+				for (u32 k = 0; k < 8; ++k)
+				{
+					c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+				}
+
+				table[i] = c;
+			}
+
+			return table;
+		}();
+
+		inline u32 distanceCode(u32 distance)
+		{
+			if (distance <= 4)
+				return distance - 1;
+
+			// two codes per power of two, picked by the bit below the top one
+			const auto d = distance - 1;
+			const auto top = static_cast<u32>(std::bit_width(d)) - 1;
+
+			return 2 * top + ((d >> (top - 1)) & 1);
+		}
+
+		inline u32 hash(const u8 *p)
+		{
+			const auto v = static_cast<u32>(p[0]) << 16 | static_cast<u32>(p[1]) << 8 | p[2];
+			return (v * 2654435761U) >> (32 - HashBits);
+		}
+
+		class BitWriter
+		{
+		public:
+			explicit BitWriter(std::vector<u8> &out)
+				: m_out{out} {}
+
+			inline void put(u32 bits, u32 count)
+			{
+				m_bits |= static_cast<u64>(bits) << m_count;
+				m_count += count;
+
+				while (m_count >= 8)
+				{
+					m_out.push_back(static_cast<u8>(m_bits));
+					m_bits >>= 8;
+					m_count -= 8;
+				}
+			}
+
+			inline void put(const Code &code)
+			{
+				put(code.bits, code.length);
+			}
+
+			// pads with zero bits up to the next byte
+			inline void align()
+			{
+				if (m_count > 0)
+					put(0, 8 - m_count);
+			}
+
+		private:
+			std::vector<u8> &m_out;
+
+			u64 m_bits{};
+			u32 m_count{};
+		};
+	}
+
+	void compress(std::span<const u8> data, bool last, std::vector<u8> &out)
+	{
+		const auto size = static_cast<u32>(data.size());
+
+		// most recent position for each hash, and the previous position with the same hash
+		std::vector<i32> head(1 << HashBits, -1);
+		std::vector<i32> prev(WindowSize, -1);
+
+		const auto insert = [&](u32 pos)
+		{
+			if (pos + MinMatch > size)
+				return;
+
+			auto &first = head[hash(&data[pos])];
+
+			prev[pos % WindowSize] = first;
+			first = static_cast<i32>(pos);
+		};
+
+		BitWriter writer{out};
+
+		writer.put(last ? 1 : 0, 1);
+		writer.put(1, 2); // fixed codes
+
+		u32 pos = 0;
+
+		while (pos < size)
+		{
+			u32 bestLength = MinMatch - 1;
+			u32 bestDistance = 0;
+
+			if (pos + MinMatch <= size)
+			{
+				const auto maxLength = std::min(MaxMatch, size - pos);
+				const auto *current = &data[pos];
+
+				auto candidate = head[hash(current)];
+
+				for (u32 chain = 0; chain < MaxChain && candidate >= 0
+					&& pos - static_cast<u32>(candidate) < WindowSize; ++chain)
+				{
+					const auto *match = &data[static_cast<u32>(candidate)];
+
+					// can't beat the best so far unless it matches one further
+					if (match[bestLength] == current[bestLength])
+					{
+						u32 length = 0;
+
+						while (length < maxLength && match[length] == current[length])
+						{
+							++length;
+						}
+
+						if (length > bestLength)
+						{
+							bestLength = length;
+							bestDistance = pos - static_cast<u32>(candidate);
+
+							if (length == maxLength)
+								break;
+						}
+					}
+
+					const auto next = prev[static_cast<u32>(candidate) % WindowSize];
+
+					// older entries get overwritten once they leave the window
+					if (next >= candidate)
+						break;
+
+					candidate = next;
+				}
+			}
+
+			if (bestDistance == 0)
+			{
+				writer.put(LiteralCodes[data[pos]]);
+				insert(pos++);
+				continue;
+			}
+
+			const auto lengthCode = LengthCodes[bestLength];
+
+			writer.put(LiteralCodes[257 + lengthCode]);
+			writer.put(bestLength - LengthBase[lengthCode], LengthExtra[lengthCode]);
+
+			const auto code = distanceCode(bestDistance);
+
+			writer.put(reverse(code, 5), 5);
+
+			if (code >= 4)
+				writer.put(bestDistance - DistanceBase[code], code / 2 - 1);
+
+			for (u32 end = pos + bestLength; pos < end; ++pos)
+			{
+				insert(pos);
+			}
+		}
+
+		writer.put(LiteralCodes[EndOfBlock]);
+
+		if (!last)
+		{
+			// empty stored block, its length fields start at the next byte
+			writer.put(0, 3);
+			writer.align();
+
+			out.insert(out.end(), {0x00, 0x00, 0xFF, 0xFF});
+		}
+		else writer.align();
+	}
+
+	u32 adler32(std::span<const u8> data, u32 adler)
+	{
+		// the most bytes that can be summed before b can overflow
+		constexpr std::size_t MaxRun = 5552;
+
+		u32 a = adler & 0xFFFF;
+		u32 b = adler >> 16;
+
+		while (!data.empty())
+		{
+			const auto run = std::min(data.size(), MaxRun);
+
+			for (std::size_t i = 0; i < run; ++i)
+			{
+				a += data[i];
+				b += a;
+			}
+
+			a %= AdlerModulus;
+			b %= AdlerModulus;
+
+			data = data.subspan(run);
+		}
+
+		return (b << 16) | a;
+	}
+
+	u32 adler32Combine(u32 first, u32 second, std::size_t secondSize)
+	{
+		// a carries straight over, and every byte of the second piece adds the first's a to b once more
+		const auto length = static_cast<u64>(secondSize % AdlerModulus);
+
+		const u64 a = ((first & 0xFFFF) + (second & 0xFFFF) + AdlerModulus - 1) % AdlerModulus;
+		const u64 b = ((first >> 16) + (second >> 16) + length * (first & 0xFFFF) + AdlerModulus - length) % AdlerModulus;
+
+		return static_cast<u32>(b << 16 | a);
+	}
+
+	u32 crc32(std::span<const u8> data, u32 crc)
+	{
+		crc = ~crc;
+
+		for (const auto byte : data)
+		{
+			crc = CrcTable[(crc ^ byte) & 0xFF] ^ (crc >> 8);
+		}
+
+		return ~crc;
+	}
+}
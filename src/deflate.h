@@ -0,0 +1,24 @@
+#pragma once
+
+#include "types.h"
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+// just enough of deflate and zlib to write pngs a piece at a time
+namespace cpurt::deflate
+{
+	// appends data as one block of fixed huffman codes, with matches only inside data.
+	// a block that isn't the last is followed by an empty stored block (zlib's sync
+	// flush), which leaves the stream byte aligned, so independently compressed pieces
+	// can simply be concatenated
+	void compress(std::span<const u8> data, bool last, std::vector<u8> &out);
+
+	// running checksums, pass the previous result to continue one
+	[[nodiscard]] u32 adler32(std::span<const u8> data, u32 adler = 1);
+	[[nodiscard]] u32 crc32(std::span<const u8> data, u32 crc = 0);
+
+	// the adler32 of two pieces back to back, from each piece's own checksum
+	[[nodiscard]] u32 adler32Combine(u32 first, u32 second, std::size_t secondSize);
+}
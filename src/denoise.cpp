@@ -0,0 +1,105 @@
+#include "denoise.h"
+
+#include <array>
+#include <cmath>
+
+#include <glm/glm.hpp>
+#include <glm/gtx/norm.hpp>
+
+namespace cpurt
+{
+	namespace
+	{
+		// b3 spline
+		constexpr std::array Kernel{1.0F / 16.0F, 1.0F / 4.0F, 3.0F / 8.0F, 1.0F / 4.0F, 1.0F / 16.0F};
+
+		constexpr f32 ColorPhi = 0.6F;
+		constexpr f32 NormalPhi = 0.1F;
+		constexpr f32 DepthPhi = 0.05F;
+		constexpr f32 AlbedoPhi = 0.05F;
+
+		constexpr f32 AlbedoEpsilon = 0.01F;
+
+		inline glm::vec3 demodulate(const glm::vec3 &color, const glm::vec3 &albedo)
+		{
+			return color / glm::max(albedo, glm::vec3{AlbedoEpsilon});
+		}
+	}
+
+	void denoiseRegion(const glm::vec3 *src, glm::vec3 *dst, const FeatureBuffers &features,
+		const DenoiseRegion &region, u32 pass, u32 passes)
+	{
+		const bool first = pass == 0;
+		const bool last = pass == passes - 1;
+
+		const auto step = static_cast<i32>(1 << pass);
+
+		// colour edges get sharper with every iteration, as the signal gets smoother
+		const auto colorPhi = ColorPhi / static_cast<f32>(1 << pass);
+
+		const auto width = static_cast<i32>(region.width);
+		const auto height = static_cast<i32>(region.height);
+
+		const auto load = [&](u32 idx)
+		{
+			return first ? demodulate(src[idx], features.albedo[idx]) : src[idx];
+		};
+
+		for (u32 y = region.startY; y < region.endY; ++y)
+		{
+			for (u32 x = region.startX; x < region.endX; ++x)
+			{
+				const auto idx = y * region.width + x;
+
+				const auto color = load(idx);
+
+				const auto &albedo = features.albedo[idx];
+				const auto &normal = features.normal[idx];
+				const auto depth = features.depth[idx];
+
+				glm::vec3 sum{};
+				f32 totalWeight = 0.0F;
+
+				for (i32 ky = 0; ky < 5; ++ky)
+				{
+					const auto sy = static_cast<i32>(y) + (ky - 2) * step;
+
+					if (sy < 0 || sy >= height)
+						continue;
+
+					for (i32 kx = 0; kx < 5; ++kx)
+					{
+						const auto sx = static_cast<i32>(x) + (kx - 2) * step;
+
+						if (sx < 0 || sx >= width)
+							continue;
+
+						const auto sampleIdx = static_cast<u32>(sy * width + sx);
+
+						const auto sampleColor = load(sampleIdx);
+
+						const auto colorDist = glm::length2(color - sampleColor) / colorPhi;
+						const auto normalDist = glm::length2(normal - features.normal[sampleIdx]) / NormalPhi;
+						const auto albedoDist = glm::length2(albedo - features.albedo[sampleIdx]) / AlbedoPhi;
+
+						const auto depthDiff = (depth - features.depth[sampleIdx]) / std::max(depth, 1.0F);
+						const auto depthDist = depthDiff * depthDiff / DepthPhi;
+
+						const auto weight = Kernel[ky] * Kernel[kx]
+							* std::exp(-colorDist - normalDist - albedoDist - depthDist);
+
+						sum += sampleColor * weight;
+						totalWeight += weight;
+					}
+				}
+
+				auto result = sum / totalWeight;
+
+				if (last)
+					result *= glm::max(albedo, glm::vec3{AlbedoEpsilon});
+
+				dst[idx] = result;
+			}
+		}
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "types.h"
+
+#include <vector>
+#include <cstddef>
+
+#include <glm/vec3.hpp>
+
+namespace cpurt
+{
+	// first-hit guide buffers, averaged over every sample of a pixel
+	struct FeatureBuffers
+	{
+		std::vector<glm::vec3> albedo{};
+		std::vector<glm::vec3> normal{};
+		std::vector<f32> depth{};
+
+		inline void resize(std::size_t size)
+		{
+			albedo.resize(size);
+			normal.resize(size);
+			depth.resize(size);
+		}
+	};
+
+	struct DenoiseRegion
+	{
+		u32 width, height;
+		u32 startX, endX;
+		u32 startY, endY;
+	};
+
+	// one iteration of an edge-avoiding a-trous wavelet filter (dammertz et al. 2010)
+	// over a region of the image, with a kernel spacing of 1 << pass. the first
+	// iteration demodulates the albedo out of the input colour, and the last
+	// (passes - 1) modulates it back in, so that texture detail is not blurred
+	void denoiseRegion(const glm::vec3 *src, glm::vec3 *dst, const FeatureBuffers &features,
+		const DenoiseRegion &region, u32 pass, u32 passes);
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "types.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <optional>
+#include <bit>
+#include <algorithm>
+
+namespace cpurt
+{
+	// chase-lev work-stealing deque of u32s (le et al. 2013, "correct and efficient
+	// work-stealing for weak memory models"). only the owning thread may push() and
+	// pop(), at the bottom; any thread may steal(), from the top
+	class WorkStealingDeque
+	{
+	public:
+		explicit WorkStealingDeque(u32 capacity = 256)
+		{
+			auto initial = std::make_unique<Buffer>(std::bit_ceil(std::max(capacity, 2U)));
+			m_buffer.store(initial.get(), std::memory_order::relaxed);
+			m_buffers.push_back(std::move(initial));
+		}
+
+		~WorkStealingDeque() = default;
+
+		WorkStealingDeque(const WorkStealingDeque &) = delete;
+		WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+		void push(u32 v)
+		{
+			const auto b = m_bottom.load(std::memory_order::relaxed);
+			const auto t = m_top.load(std::memory_order::acquire);
+
+			auto *buffer = m_buffer.load(std::memory_order::relaxed);
+
+			if (b - t > static_cast<i64>(buffer->capacity) - 1)
+				buffer = grow(buffer, t, b);
+
+			buffer->put(b, v);
+
+			std::atomic_thread_fence(std::memory_order::release);
+			m_bottom.store(b + 1, std::memory_order::relaxed);
+		}
+
+		[[nodiscard]] std::optional<u32> pop()
+		{
+			const auto b = m_bottom.load(std::memory_order::relaxed) - 1;
+			auto *buffer = m_buffer.load(std::memory_order::relaxed);
+
+			m_bottom.store(b, std::memory_order::relaxed);
+			std::atomic_thread_fence(std::memory_order::seq_cst);
+
+			auto t = m_top.load(std::memory_order::relaxed);
+
+			if (t > b)
+			{
+				// empty
+				m_bottom.store(b + 1, std::memory_order::relaxed);
+				return {};
+			}
+
+			std::optional<u32> v = buffer->get(b);
+
+			if (t == b)
+			{
+				// last element, race any thieves for it
+				if (!m_top.compare_exchange_strong(t, t + 1,
+					std::memory_order::seq_cst, std::memory_order::relaxed))
+					v.reset();
+
+				m_bottom.store(b + 1, std::memory_order::relaxed);
+			}
+
+			return v;
+		}
+
+		// spurious failure (losing a race to another thief) is reported as empty
+		[[nodiscard]] std::optional<u32> steal()
+		{
+			auto t = m_top.load(std::memory_order::acquire);
+			std::atomic_thread_fence(std::memory_order::seq_cst);
+			const auto b = m_bottom.load(std::memory_order::acquire);
+
+			if (t >= b)
+				return {};
+
+			// consume, in spirit
+			const auto *buffer = m_buffer.load(std::memory_order::acquire);
+			const auto v = buffer->get(t);
+
+			if (!m_top.compare_exchange_strong(t, t + 1,
+				std::memory_order::seq_cst, std::memory_order::relaxed))
+				return {};
+
+			return v;
+		}
+
+		[[nodiscard]] inline bool empty() const
+		{
+			return m_bottom.load(std::memory_order::relaxed) <= m_top.load(std::memory_order::relaxed);
+		}
+
+	private:
+		struct Buffer
+		{
+			explicit Buffer(u32 capacity)
+				: capacity{capacity},
+				  mask{capacity - 1},
+				  slots{std::make_unique<std::atomic<u32>[]>(capacity)} {}
+
+			u32 capacity;
+			u32 mask;
+			std::unique_ptr<std::atomic<u32>[]> slots;
+
+			[[nodiscard]] inline u32 get(i64 i) const
+			{
+				return slots[static_cast<u64>(i) & mask].load(std::memory_order::relaxed);
+			}
+
+			inline void put(i64 i, u32 v)
+			{
+				slots[static_cast<u64>(i) & mask].store(v, std::memory_order::relaxed);
+			}
+		};
+
+		Buffer *grow(Buffer *old, i64 t, i64 b)
+		{
+			auto grown = std::make_unique<Buffer>(old->capacity * 2);
+
+			for (auto i = t; i < b; ++i)
+			{
+				grown->put(i, old->get(i));
+			}
+
+			auto *buffer = grown.get();
+
+			// thieves may still be reading the old buffer, so it is only freed with the deque
+			m_buffers.push_back(std::move(grown));
+			m_buffer.store(buffer, std::memory_order::release);
+
+			return buffer;
+		}
+
+		alignas(64) std::atomic<i64> m_top{0};
+		alignas(64) std::atomic<i64> m_bottom{0};
+		alignas(64) std::atomic<Buffer *> m_buffer{};
+
+		// owner only
+		std::vector<std::unique_ptr<Buffer>> m_buffers{};
+	};
+}
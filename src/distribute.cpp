@@ -0,0 +1,295 @@
+#include "distribute.h"
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <algorithm>
+#include <limits>
+#include <csignal>
+
+#include <unistd.h>
+
+#include "net.h"
+#include "timer.h"
+
+namespace cpurt
+{
+	namespace
+	{
+		// more jobs than workers, so faster machines take more of them
+		constexpr u32 JobsPerWorker = 4;
+
+		// samples per job when sharding by samples. fixed rather than a share per
+		// worker, so the merged sums come out the same however many workers there are
+		constexpr u32 SamplesPerJob = 16;
+
+		struct Job
+		{
+			u32 index;
+
+			u32 startY, endY;
+			u32 firstSample, samples;
+		};
+
+		struct JobResult
+		{
+			const Job *job;
+
+			std::vector<glm::vec3> color;
+			std::vector<u32> samples;
+		};
+
+		std::vector<Job> splitJobs(ShardMode mode, u32 height, u32 samples, u32 jobCount)
+		{
+			std::vector<Job> jobs{};
+
+			if (mode == ShardMode::Tiles)
+			{
+				// whole tile rows, so workers tile their bands the same way
+				const auto tileRows = (height + TileSize - 1) / TileSize;
+				const auto bandRows = std::max((tileRows + jobCount - 1) / jobCount, 1U);
+
+				for (u32 y = 0; y < height; y += bandRows * TileSize)
+				{
+					jobs.push_back({
+						.index = static_cast<u32>(jobs.size()),
+						.startY = y,
+						.endY = std::min(height, y + bandRows * TileSize),
+						.firstSample = 0,
+						.samples = samples
+					});
+				}
+			}
+			else
+			{
+				for (u32 first = 0; first < samples; first += SamplesPerJob)
+				{
+					jobs.push_back({
+						.index = static_cast<u32>(jobs.size()),
+						.startY = 0,
+						.endY = height,
+						.firstSample = first,
+						.samples = std::min(SamplesPerJob, samples - first)
+					});
+				}
+			}
+
+			return jobs;
+		}
+
+		std::string jobRequest(const DistributeSettings &settings, const Camera &camera,
+			const Framebuffer &framebuffer, const Job &job)
+		{
+			std::ostringstream request{};
+
+			// enough digits that every float parses back to exactly the same value
+			request << std::setprecision(std::numeric_limits<f32>::max_digits10);
+
+			const auto &pos = camera.pos();
+			const auto &target = camera.target();
+
+			request << "render scene=" << settings.scene
+				<< " width=" << camera.width() << " height=" << camera.height()
+				<< " region=0," << job.startY << ',' << camera.width() << ',' << (job.endY - job.startY)
+				<< " samples=" << job.samples << " first-sample=" << job.firstSample
+				<< " seed=" << framebuffer.seed
+				<< " pos=" << pos.x << ',' << pos.y << ',' << pos.z
+				<< " target=" << target.x << ',' << target.y << ',' << target.z
+				<< " fov=" << camera.fovY() << " aperture=" << camera.aperture() << " focus=" << camera.focalLength()
+				<< " format=accum\n";
+
+			return request.str();
+		}
+
+		bool runJob(Connection &connection, const std::string &request, JobResult &result, u32 width, u32 height)
+		{
+			if (!connection.write(request))
+				return false;
+
+			std::string line{};
+
+			if (!connection.readLine(line))
+				return false;
+
+			std::istringstream header{line};
+
+			std::string type{}, format{};
+			u32 replyWidth{}, replyHeight{}, samples{};
+			std::size_t size{};
+
+			header >> type >> replyWidth >> replyHeight >> samples >> format >> size;
+
+			const auto pixels = static_cast<std::size_t>(width) * height;
+
+			if (type != "image" || format != "accum" || replyWidth != width || replyHeight != height
+				|| size != pixels * (sizeof(glm::vec3) + sizeof(u32)))
+			{
+				std::cerr << "unexpected reply: " << line << std::endl;
+				return false;
+			}
+
+			result.color.resize(pixels);
+			result.samples.resize(pixels);
+
+			return connection.readExact(result.color.data(), pixels * sizeof(glm::vec3))
+				&& connection.readExact(result.samples.data(), pixels * sizeof(u32))
+				&& connection.readLine(line) && line.starts_with("done");
+		}
+
+		void merge(Framebuffer &framebuffer, const JobResult &result)
+		{
+			const auto offset = static_cast<std::size_t>(result.job->startY) * framebuffer.width;
+
+			for (std::size_t i = 0; i < result.color.size(); ++i)
+			{
+				framebuffer.color[offset + i] += result.color[i];
+				framebuffer.samples[offset + i] += result.samples[i];
+			}
+		}
+	}
+
+	bool renderDistributed(const DistributeSettings &settings, const Camera &camera, Framebuffer &framebuffer)
+	{
+		if (settings.workers.empty())
+		{
+			std::cerr << "no workers" << std::endl;
+			return false;
+		}
+
+		// a worker dying mid-job shows up as a failed write, and its job gets requeued
+		std::signal(SIGPIPE, SIG_IGN);
+
+		Timer timer{};
+
+		const auto jobs = splitJobs(settings.mode, camera.height(), settings.samples,
+			static_cast<u32>(settings.workers.size()) * JobsPerWorker);
+
+		std::mutex mutex{};
+
+		std::condition_variable signal{};
+
+		std::deque<const Job *> queue{};
+
+		u32 inFlight = 0;
+		u32 finished = 0;
+
+		for (const auto &job : jobs)
+		{
+			queue.push_back(&job);
+		}
+
+		// sample ranges overlap, and are summed in job order so the result doesn't depend on
+		// which worker finished first. bands don't overlap and go straight in
+		std::map<u32, JobResult> pending{};
+		u32 nextMerge = 0;
+
+		std::vector<std::thread> threads{};
+
+		for (const auto &address : settings.workers)
+		{
+			threads.emplace_back([&, address]
+			{
+				const auto socket = connectTo(address);
+
+				if (socket < 0)
+					return;
+
+				Connection connection{socket};
+
+				u32 completed = 0;
+				bool failed = false;
+
+				while (true)
+				{
+					const Job *job;
+
+					{
+						std::unique_lock lock{mutex};
+
+						// jobs still running elsewhere may fail and come back
+						signal.wait(lock, [&] { return !queue.empty() || inFlight == 0; });
+
+						if (queue.empty())
+							break;
+
+						job = queue.front();
+						queue.pop_front();
+
+						++inFlight;
+					}
+
+					JobResult result{.job = job};
+
+					if (!runJob(connection, jobRequest(settings, camera, framebuffer, *job),
+						result, camera.width(), job->endY - job->startY))
+					{
+						std::cerr << "worker " << address << " failed, requeueing job " << job->index << std::endl;
+
+						std::scoped_lock lock{mutex};
+
+						queue.push_back(job);
+						--inFlight;
+
+						signal.notify_all();
+
+						failed = true;
+						break;
+					}
+
+					++completed;
+
+					std::scoped_lock lock{mutex};
+
+					if (settings.mode == ShardMode::Tiles)
+						merge(framebuffer, result);
+					else
+					{
+						pending.emplace(job->index, std::move(result));
+
+						for (auto next = pending.find(nextMerge); next != pending.end(); next = pending.find(nextMerge))
+						{
+							merge(framebuffer, next->second);
+							pending.erase(next);
+
+							++nextMerge;
+						}
+					}
+
+					--inFlight;
+					++finished;
+
+					signal.notify_all();
+				}
+
+				if (!failed)
+					(void)connection.write("quit\n");
+
+				close(socket);
+
+				std::scoped_lock lock{mutex};
+				std::cout << "worker " << address << ": " << completed << " jobs" << std::endl;
+			});
+		}
+
+		for (auto &thread : threads)
+		{
+			thread.join();
+		}
+
+		if (finished < jobs.size())
+		{
+			std::cerr << "only " << finished << " of " << jobs.size() << " jobs finished" << std::endl;
+			return false;
+		}
+
+		std::cout << "distributed render time: " << (timer.time() * 1000.0) << " ms ("
+			<< jobs.size() << " jobs over " << settings.workers.size() << " workers)" << std::endl;
+
+		return true;
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "types.h"
+
+#include <string>
+#include <vector>
+
+#include "camera.h"
+#include "framebuffer.h"
+
+namespace cpurt
+{
+	enum class ShardMode : u32
+	{
+		// bands of rows, merged result is bit-identical however the image is split
+		Tiles = 0,
+		// fixed size ranges of each pixel's samples, identical for any number of workers
+		// but not bit-identical to a local render (sums of ranges round differently)
+		Samples,
+		_last
+	};
+
+	struct DistributeSettings
+	{
+		// render servers, see server.h and net.h
+		std::vector<std::string> workers{};
+		ShardMode mode{ShardMode::Tiles};
+
+		std::string scene{"random"};
+		u32 samples{Samples};
+	};
+
+	// renders framebuffer (sized to the camera's image, seeded and empty) on the workers,
+	// handing out jobs as they finish. false if every worker failed before the image was done
+	bool renderDistributed(const DistributeSettings &settings, const Camera &camera, Framebuffer &framebuffer);
+}
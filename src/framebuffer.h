@@ -0,0 +1,77 @@
+#pragma once
+
+#include "types.h"
+
+#include <vector>
+#include <algorithm>
+
+#include <glm/vec3.hpp>
+
+#include "config.h"
+#include "denoise.h"
+
+namespace cpurt
+{
+	// linear radiance, summed over every sample taken so far
+	struct Framebuffer
+	{
+		u32 width{}, height{};
+
+		// together with each pixel's sample count, fully determines the
+		// random numbers used for the next samples of that pixel
+		u32 seed{};
+
+		// how far into each pixel's random stream the sample counts start, to pick up
+		// where a render of the first samples left off. the counts only cover this buffer
+		u32 firstSample{};
+
+		// where this buffer sits in the camera's image, when it only holds part of it
+		u32 originX{}, originY{};
+
+		std::vector<glm::vec3> color{};
+		std::vector<u32> samples{};
+
+		// also sums, only populated when denoising
+		FeatureBuffers features{};
+
+		Framebuffer() = default;
+
+		Framebuffer(u32 width, u32 height, u32 seed)
+			: width{width},
+			  height{height},
+			  seed{seed}
+		{
+			clear();
+		}
+
+		inline void clear()
+		{
+			const auto size = static_cast<std::size_t>(width) * height;
+
+			color.assign(size, glm::vec3{});
+			samples.assign(size, 0);
+
+			if constexpr(Denoise)
+			{
+				features.albedo.assign(size, glm::vec3{});
+				features.normal.assign(size, glm::vec3{});
+				features.depth.assign(size, 0.0F);
+			}
+		}
+	};
+
+	// linear, per-pixel averaged image, ready for post-processing
+	struct HdrImage
+	{
+		u32 width{}, height{};
+		std::vector<glm::vec3> pixels{};
+
+		inline void resize(u32 newWidth, u32 newHeight)
+		{
+			width = newWidth;
+			height = newHeight;
+
+			pixels.resize(static_cast<std::size_t>(width) * height);
+		}
+	};
+}
@@ -0,0 +1,90 @@
+#include "hugepage.h"
+
+#include <new>
+#include <atomic>
+
+#include <sys/mman.h>
+
+#include "config.h"
+
+namespace cpurt::hugepages
+{
+	namespace
+	{
+		std::atomic<bool> s_enabled{HugePages};
+
+		inline std::size_t roundUp(std::size_t bytes)
+		{
+			return (bytes + PageSize - 1) / PageSize * PageSize;
+		}
+
+		void *map(std::size_t bytes, i32 flags)
+		{
+			auto *ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+			return ptr == MAP_FAILED ? nullptr : ptr;
+		}
+	}
+
+	void *allocate(std::size_t bytes)
+	{
+		if (bytes < Threshold)
+			return ::operator new(bytes);
+
+		// everything at or above the threshold is mapped, in whole huge pages,
+		// so deallocate() can tell from the size alone how to release it
+		bytes = roundUp(bytes);
+
+		if (!enabled())
+		{
+			auto *ptr = map(bytes, 0);
+
+			if (!ptr)
+				throw std::bad_alloc{};
+
+			madvise(ptr, bytes, MADV_NOHUGEPAGE);
+			return ptr;
+		}
+
+		// only succeeds if huge pages have been reserved (vm.nr_hugepages)
+		if (auto *ptr = map(bytes, MAP_HUGETLB))
+			return ptr;
+
+		// 2 MiB aligned, so that the whole range can be backed by huge pages
+		const auto padded = bytes + PageSize;
+		auto *base = static_cast<u8 *>(map(padded, 0));
+
+		if (!base)
+			throw std::bad_alloc{};
+
+		const auto address = reinterpret_cast<std::uintptr_t>(base);
+		auto *aligned = base + (roundUp(address) - address);
+
+		if (aligned > base)
+			munmap(base, aligned - base);
+
+		if (const auto tail = (base + padded) - (aligned + bytes); tail > 0)
+			munmap(aligned + bytes, tail);
+
+		// a hint, failing just leaves the range on 4k pages
+		madvise(aligned, bytes, MADV_HUGEPAGE);
+
+		return aligned;
+	}
+
+	void deallocate(void *ptr, std::size_t bytes)
+	{
+		if (bytes < Threshold)
+			::operator delete(ptr);
+		else munmap(ptr, roundUp(bytes));
+	}
+
+	void setEnabled(bool enabled)
+	{
+		s_enabled.store(enabled, std::memory_order::relaxed);
+	}
+
+	bool enabled()
+	{
+		return s_enabled.load(std::memory_order::relaxed);
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "types.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace cpurt
+{
+	namespace hugepages
+	{
+		constexpr std::size_t PageSize = 2 * 1024 * 1024;
+
+		// smaller allocations come from the regular heap
+		constexpr std::size_t Threshold = PageSize;
+
+		// tries explicit (hugetlbfs) pages, then transparent ones, then plain pages.
+		// throws std::bad_alloc if nothing works
+		[[nodiscard]] void *allocate(std::size_t bytes);
+		void deallocate(void *ptr, std::size_t bytes);
+
+		// affects later allocations only, defaults to HugePages from config.h.
+		// when disabled, large allocations are explicitly kept off transparent huge pages
+		void setEnabled(bool enabled);
+		[[nodiscard]] bool enabled();
+	}
+
+	// for large, randomly accessed arrays (bvh nodes, primitives) where 4k pages thrash the tlb
+	template <typename T>
+	class HugePageAllocator
+	{
+	public:
+		using value_type = T;
+
+		HugePageAllocator() = default;
+
+		template <typename U>
+		HugePageAllocator(const HugePageAllocator<U> &) {}
+
+		[[nodiscard]] inline T *allocate(std::size_t n)
+		{
+			return static_cast<T *>(hugepages::allocate(n * sizeof(T)));
+		}
+
+		inline void deallocate(T *ptr, std::size_t n)
+		{
+			hugepages::deallocate(ptr, n * sizeof(T));
+		}
+
+		template <typename U>
+		inline bool operator==(const HugePageAllocator<U> &) const { return true; }
+	};
+
+	template <typename T>
+	using HugePageVector = std::vector<T, HugePageAllocator<T>>;
+}
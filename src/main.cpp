@@ -1,176 +1,357 @@
 #include <iostream>
 #include <string>
 #include <algorithm>
+#include <future>
+#include <filesystem>
 #include <sstream>
 #include <iomanip>
-#include <ctime>
+#include <cmath>
 
 #include "types.h"
 
+#include <glm/gtc/constants.hpp>
+
 #include "config.h"
 #include "scene.h"
 #include "camera.h"
 #include "render.h"
 #include "rng.h"
-
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "3rdparty/stb_image_write.h"
+#include "framebuffer.h"
+#include "output.h"
+#include "options.h"
+#include "timer.h"
+#include "checkpoint.h"
+#include "scenes.h"
+#include "server.h"
+#include "sharedimage.h"
+#include "preview.h"
 
 using namespace cpurt;
 
 namespace
 {
-	const Sphere &initTestScene(Scene &scene)
-	{
-		const auto ground = scene.createDiffuse({0.8F, 0.8F, 0.0F}).id;
+	// seconds between progress reports while waiting on a background render
+	constexpr f64 ProgressInterval = 4.0;
 
-	//	const auto left = scene.createMetal({0.8F, 0.8F, 0.8F}, 0.3F).id;
-		const auto left = scene.createDielectric({1.0F, 1.0F, 1.0F}, 1.52F).id;
+	void writeToFile(ImageFormat format, u32 width, u32 height, const u32 *data, Scheduler &pool)
+	{
+		const auto filename = timestampFilename(extension(format));
 
-	//	const auto center = scene.createDiffuse({0.7F, 0.3F, 0.3F}).id;
-		const auto center = scene.createDiffuse({0.1F, 0.2F, 0.5F}).id;
+		Timer timer{};
 
-	//	const auto right = scene.createMetal({0.8F, 0.6F, 0.2F}, 0.0F).id;
-	//	const auto right = scene.createDielectric({1.0F, 1.0F, 1.0F}, 1.5F).id;
-	//	const auto right = scene.createLight({4.8F, 3.6F, 1.2F}).id;
-		const auto right = scene.createLight({-4.8F, -3.6F, -1.2F}).id;
+		std::vector<u8> encoded{};
 
-		scene.createSphere({ // ground
-			.pos = {0.0F, -100.5F, 0.0F},
-			.radius = 100.0F,
-			.materialId = ground
-		});
+		if (!encodeImage(format, width, height, data, encoded, &pool))
+		{
+			std::cerr << "failed to encode " << filename << std::endl;
+			return;
+		}
 
-		scene.createSphere({ // left
-			.pos = {-1.0F, 0.0F, 0.0F},
-			.radius = 0.5F,
-			.materialId = left
-		});
+		const auto encodeTime = timer.time();
 
-		const auto &centerSphere = scene.createSphere({ // center
-			.pos = {0.0F, 0.0F, 0.0F},
-			.radius = 0.5F,
-			.materialId = center
-		});
+		if (writeFile(filename, encoded))
+			std::cout << "wrote " << encoded.size() << " bytes to " << filename
+				<< " (encode " << (encodeTime * 1000.0) << " ms, write "
+				<< ((timer.time() - encodeTime) * 1000.0) << " ms)" << std::endl;
+		else std::cerr << "failed to write to " << filename << std::endl;
+	}
 
-		scene.createSphere({ // right
-			.pos = {1.0F, 0.0F, 0.0F},
-			.radius = 0.5F,
-			.materialId = right
-		});
+	void writeHdrToFile(const HdrImage &image)
+	{
+		const auto filename = timestampFilename("pfm");
 
-		return centerSphere;
+		if (writePfm(filename, image))
+			std::cout << "wrote to " << filename << std::endl;
+		else std::cerr << "failed to write to " << filename << std::endl;
 	}
+}
 
-	void initRandomScene(Scene &scene)
-	{
-		Rng rng{0x696969};
+int main(int argc, const char *argv[])
+{
+	const auto options = parseOptions(argc, argv);
 
-		const auto groundMaterial = scene.createDiffuse({0.5F, 0.5F, 0.5F}).id;
-		scene.createSphere({
-			.pos = {0.0F, -1000.0F, 0.0F},
-			.radius = 1000.0F,
-			.materialId = groundMaterial
-		});
+	if (!options)
+		return 1;
 
-		const auto glass = scene.createDielectric({1.0F, 1.0F, 1.0F}, 1.52F).id;
+	if (options->serve)
+		return runServer(*options->serve, *options);
 
-		for (i32 a = -11; a < 11; ++a)
-		{
-			for (i32 b = -11; b < 11; ++b)
-			{
-				const glm::vec3 center {
-					static_cast<f32>(a) + 0.9F * rng.nextF32(),
-					0.2F,
-					static_cast<f32>(b) + 0.9F * rng.nextF32()
-				};
+	Renderer renderer{};
+	renderer.tileOrder(options->tileOrder);
+	renderer.pixelOrder(options->pixelOrder);
 
-				if (glm::length(center - glm::vec3{4.0F, 0.2F, 0.0F}) > 0.9F)
-				{
-					const auto materialSelector = rng.nextF32();
-					u32 material;
-
-					if (materialSelector < 0.8F)
-						material = scene.createDiffuse(rng.nextColor() * rng.nextColor()).id;
-					else if (materialSelector < 0.95F)
-						material = scene.createMetal(rng.nextColor() * 0.5F + 0.5F, rng.nextF32() * 0.5F).id;
-					else material = glass;
-
-					scene.createSphere({
-						.pos = center,
-						.radius = 0.2F,
-						.materialId = material
-					});
-				}
-			//	else std::cout << "skipping sphere" << std::endl;
-			}
-		}
+	if (options->regrade)
+	{
+		HdrImage image{};
 
-		scene.createSphere({
-			.pos = {0.0F, 1.0F, 0.0F},
-			.radius = 1.0F,
-			.materialId = glass
-		});
+		if (!readPfm(*options->regrade, image))
+			return 1;
 
-		const auto material2 = scene.createDiffuse({0.4F, 0.2F, 0.1F}).id;
-		scene.createSphere({
-			.pos = {-4.0F, 1.0F, 0.0F},
-			.radius = 1.0F,
-			.materialId = material2
-		});
+		std::vector<u32> buffer{};
+		buffer.resize(image.width * image.height);
 
-		const auto material3 = scene.createMetal({0.7F, 0.6F, 0.5F}, 0.0F).id;
-		scene.createSphere({
-			.pos = {4.0F, 1.0F, 0.0F},
-			.radius = 1.0F,
-			.materialId = material3
-		});
+		renderer.resolve(image, options->post, buffer.data());
+
+		writeToFile(options->format, image.width, image.height, buffer.data(), renderer.scheduler());
+
+		return 0;
 	}
 
-	void writeToFile(u32 width, u32 height, const u32 *data)
+	const auto seed = options->seed ? *options->seed : Rng{}.nextU32();
+
+	if (options->frames)
 	{
-		const auto time = std::time(nullptr);
-		const auto *tm = std::localtime(&time);
+		const auto prefix = timestampFilename("");
+		const auto frames = *options->frames;
+
+		renderer.drawSequence({
+				.frames = frames,
+				.seed = seed,
+				.post = options->post
+			},
+			[frames](u32 frame, Scene &scene, Camera &camera)
+			{
+				initRandomScene(scene);
+
+				// one full turn around the origin, starting from the still camera's position
+				const auto angle = std::atan2(3.0F, 13.0F)
+					+ glm::two_pi<f32>() * static_cast<f32>(frame) / static_cast<f32>(frames);
+				const auto radius = std::hypot(13.0F, 3.0F);
+
+				camera = Camera{Width, Height, 20.0F, 0.1F, 10.0F};
+
+				camera.pos() = {radius * std::cos(angle), 2.0F, radius * std::sin(angle)};
+				camera.target() = {0.0F, 0.0F, 0.0F};
+			},
+			[&](u32 frame, const HdrImage &image, const u32 *pixels)
+			{
+				std::ostringstream name{};
+				name << prefix << std::setw(4) << std::setfill('0') << frame;
+
+				if (options->writeHdr && !writePfm(name.str() + ".pfm", image))
+					std::cerr << "failed to write to " << name.str() << ".pfm" << std::endl;
 
-		std::ostringstream filename{};
-		filename << std::put_time(tm, "%Y-%m-%d_%H.%M.%S") << ".png";
+				// the pool is busy with the next frame
+				const auto filename = name.str() + '.' + std::string{extension(options->format)};
 
-		if (stbi_write_png(filename.str().c_str(),
-			static_cast<i32>(width), static_cast<i32>(height),
-			4, data, static_cast<i32>(width * sizeof(u32))))
-			std::cout << "wrote to " << filename.view() << std::endl;
-		else std::cerr << "failed to write to " << filename.view() << std::endl;
+				std::vector<u8> encoded{};
+
+				if (!encodeImage(options->format, image.width, image.height, pixels, encoded)
+					|| !writeFile(filename, encoded))
+					std::cerr << "failed to write to " << filename << std::endl;
+			});
+
+		return 0;
 	}
-}
 
-int main()
-{
 	Scene scene{};
-//	const auto &sphere = initTestScene(scene);
+
+//	const auto sphere = initTestScene(scene);
 	initRandomScene(scene);
 
 	scene.buildBvh();
 
-	Renderer renderer{scene};
-
 //	Camera camera{Width, Height, 90.0F, 0.001F, 1.0F};
 	Camera camera{Width, Height, 20.0F, 0.1F, 10.0F};
 
 //	camera.pos() = {0.0F, 0.0F, 2.0F};
 //	camera.target() = {0.0F, 0.0F, -1.0F};
-//	camera.target() = sphere.pos;
+//	camera.target() = scene.sphere(sphere).pos;
 
 	camera.pos() = {13.0F, 2.0F, 3.0F};
 	camera.target() = {0.0F, 0.0F, 0.0F};
 
 	camera.update();
 
+	SharedImage shared{};
+
+	if (options->shared)
+	{
+		if (!shared.open(*options->shared, options->sharedFormat, Width, Height, options->post))
+			return 1;
+
+		renderer.regionDone([&shared](const Framebuffer &current, u32 startX, u32 endX, u32 startY, u32 endY)
+		{
+			shared.publish(current, startX, endX, startY, endY);
+		});
+	}
+
+	if (options->preview)
+	{
+		const auto previewFilename = timestampFilename("preview." + std::string{extension(options->format)});
+
+		std::vector<u8> encoded{};
+
+		PreviewSession session{renderer, scene, {
+				.seed = seed,
+				.post = options->post
+			},
+			[&](const PreviewImage &preview)
+			{
+				// the pool is idle between preview steps
+				if (!encodeImage(options->format, preview.image.width, preview.image.height,
+					preview.pixels, encoded, &renderer.scheduler()))
+					return;
+
+				const auto tempFilename = previewFilename + ".tmp";
+
+				std::error_code error{};
+
+				if (writeFile(tempFilename, encoded)
+					&& (std::filesystem::rename(tempFilename, previewFilename, error), !error))
+				{
+					std::cout << "wrote 1/" << preview.stride << " resolution, " << preview.samples << " spp preview at "
+						<< (preview.time * 1000.0) << " ms to " << previewFilename << std::endl;
+				}
+				else std::cerr << "failed to write preview to " << previewFilename << std::endl;
+			}};
+
+		session.setCamera(camera);
+		session.wait();
+
+		return 0;
+	}
+
+	if (options->stream)
+	{
+		const auto filename = timestampFilename(extension(options->format));
+
+		ImageStream stream{};
+
+		if (!stream.open(filename, options->format, Width, Height))
+			return 1;
+
+		bool written = true;
+
+		renderer.drawBands(scene, camera, {
+				.seed = seed,
+				.post = options->post
+			},
+			[&](u32, u32 rows, const u32 *pixels)
+			{
+				written = written && stream.write(pixels, rows);
+			});
+
+		if (shared.valid())
+			shared.finish();
+
+		if (!written || !stream.close())
+		{
+			std::cerr << "failed to write to " << filename << std::endl;
+			return 1;
+		}
+
+		std::cout << "wrote to " << filename << std::endl;
+
+		return 0;
+	}
+
+	Framebuffer framebuffer{Width, Height, seed};
+
+	if (options->resume)
+	{
+		if (!readCheckpoint(*options->resume, framebuffer))
+			return 1;
+
+		if (framebuffer.width != Width || framebuffer.height != Height)
+		{
+			std::cerr << "checkpoint is " << framebuffer.width << "x" << framebuffer.height
+				<< ", expected " << Width << "x" << Height << std::endl;
+			return 1;
+		}
+	}
+
+	if (!options->distribute.empty())
+	{
+		if (!renderDistributed({
+				.workers = options->distribute,
+				.mode = options->shard
+			}, camera, framebuffer))
+			return 1;
+	}
+	else if (options->progressive)
+	{
+		const auto previewFilename = timestampFilename("preview.png");
+
+		HdrImage preview{};
+		std::vector<u32> previewBuffer(Width * Height);
+
+		// encoding overlaps with the next pass
+		std::future<void> pendingPreview{};
+
+		renderer.drawProgressive(scene, camera, framebuffer, *options->progressive,
+			[&](const Framebuffer &current, u32 samples)
+			{
+				if (pendingPreview.valid())
+					pendingPreview.wait();
+
+				renderer.develop(current, preview);
+				renderer.resolve(preview, options->post, previewBuffer.data());
+
+				pendingPreview = std::async(std::launch::async, [&previewFilename, &previewBuffer, samples]
+				{
+					// written aside and renamed so readers never see a partial file
+					const auto tempFilename = previewFilename + ".tmp";
+
+					std::error_code error{};
+
+					if (writePng(tempFilename, Width, Height, previewBuffer.data())
+						&& (std::filesystem::rename(tempFilename, previewFilename, error), !error))
+					{
+						std::cout << "wrote " << samples << " spp preview to " << previewFilename << std::endl;
+					}
+					else std::cerr << "failed to write preview to " << previewFilename << std::endl;
+				});
+			},
+			[&](const Framebuffer &current, u32 samples)
+			{
+				if (!options->checkpoint)
+					return;
+
+				Timer timer{};
+
+				if (writeCheckpoint(*options->checkpoint, current))
+					std::cout << "checkpointed " << samples << " spp to " << *options->checkpoint
+						<< " (" << (timer.time() * 1000.0) << " ms)" << std::endl;
+			});
+
+		if (pendingPreview.valid())
+			pendingPreview.wait();
+	}
+	else if (options->deadline)
+	{
+		const auto job = renderer.drawAsync(scene, camera, framebuffer, {
+			.deadline = *options->deadline
+		});
+
+		while (!job.waitFor(ProgressInterval))
+			std::cout << "progress: " << (job.progress() * 100.0F) << "%" << std::endl;
+
+		const auto result = job.wait();
+
+		if (result.status != RenderStatus::Complete)
+			std::cout << "stopped at the deadline with " << result.minSamples << "-" << result.maxSamples
+				<< " spp of " << Samples << std::endl;
+	}
+	else if (options->budget)
+		renderer.drawBudgeted(scene, camera, framebuffer, *options->budget);
+	else renderer.draw(scene, camera, framebuffer);
+
+	HdrImage image{};
+	renderer.develop(framebuffer, image);
+
+	if (shared.valid())
+		shared.finish(image);
+
+	if (options->writeHdr)
+		writeHdrToFile(image);
+
 	std::vector<u32> buffer{};
 	buffer.resize(Width * Height);
 
-	renderer.draw(camera, buffer.data(), Width, Height);
+	renderer.resolve(image, options->post, buffer.data());
 
-	writeToFile(Width, Height, buffer.data());
+	writeToFile(options->format, Width, Height, buffer.data(), renderer.scheduler());
 
 	return 0;
 }
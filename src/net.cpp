@@ -0,0 +1,254 @@
+#include "net.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+namespace cpurt
+{
+	namespace
+	{
+		constexpr std::string_view TcpPrefix = "tcp:";
+
+		// host is empty for tcp:<port>
+		bool splitTcpAddress(const std::string &address, std::string &host, std::string &port)
+		{
+			if (!address.starts_with(TcpPrefix))
+				return false;
+
+			const auto rest = address.substr(TcpPrefix.size());
+
+			if (const auto colon = rest.rfind(':'); colon != std::string::npos)
+			{
+				host = rest.substr(0, colon);
+				port = rest.substr(colon + 1);
+			}
+			else
+			{
+				host.clear();
+				port = rest;
+			}
+
+			return true;
+		}
+
+		i32 unixSocket(const std::string &path, sockaddr_un &address)
+		{
+			address = {};
+			address.sun_family = AF_UNIX;
+
+			if (path.size() >= sizeof(address.sun_path))
+			{
+				std::cerr << "socket path too long: " << path << std::endl;
+				return -1;
+			}
+
+			std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+			const auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+			if (fd < 0)
+				std::cerr << "failed to create socket: " << std::strerror(errno) << std::endl;
+
+			return fd;
+		}
+
+		// tries every address the lookup returns
+		template <typename F>
+		i32 tcpSocket(const std::string &host, const std::string &port, bool passive, F &&func)
+		{
+			addrinfo hints{};
+			hints.ai_family = AF_UNSPEC;
+			hints.ai_socktype = SOCK_STREAM;
+			hints.ai_flags = passive ? AI_PASSIVE : 0;
+
+			addrinfo *results{};
+
+			if (const auto error = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &results);
+				error != 0)
+			{
+				std::cerr << "failed to resolve " << host << ':' << port << ": " << gai_strerror(error) << std::endl;
+				return -1;
+			}
+
+			i32 fd = -1;
+
+			for (auto *info = results; info; info = info->ai_next)
+			{
+				fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+
+				if (fd < 0)
+					continue;
+
+				if (func(fd, *info))
+					break;
+
+				close(fd);
+				fd = -1;
+			}
+
+			freeaddrinfo(results);
+
+			if (fd < 0)
+				std::cerr << "failed to " << (passive ? "listen on " : "connect to ") << host << ':' << port
+					<< ": " << std::strerror(errno) << std::endl;
+
+			return fd;
+		}
+	}
+
+	bool Connection::readLine(std::string &line)
+	{
+		while (true)
+		{
+			if (const auto end = m_buffer.find('\n'); end != std::string::npos)
+			{
+				line = m_buffer.substr(0, end);
+				m_buffer.erase(0, end + 1);
+
+				if (!line.empty() && line.back() == '\r')
+					line.pop_back();
+
+				return true;
+			}
+
+			char chunk[4096];
+			const auto count = ::read(m_in, chunk, sizeof(chunk));
+
+			if (count <= 0)
+				return false;
+
+			m_buffer.append(chunk, count);
+		}
+	}
+
+	bool Connection::readExact(void *data, std::size_t size)
+	{
+		auto *bytes = static_cast<u8 *>(data);
+
+		// whatever readLine() already pulled in first
+		const auto buffered = std::min(size, m_buffer.size());
+
+		std::memcpy(bytes, m_buffer.data(), buffered);
+		m_buffer.erase(0, buffered);
+
+		bytes += buffered;
+		size -= buffered;
+
+		while (size > 0)
+		{
+			const auto count = ::read(m_in, bytes, size);
+
+			if (count <= 0)
+				return false;
+
+			bytes += count;
+			size -= count;
+		}
+
+		return true;
+	}
+
+	bool Connection::write(const void *data, std::size_t size)
+	{
+		const auto *bytes = static_cast<const u8 *>(data);
+
+		while (size > 0)
+		{
+			const auto written = ::write(m_out, bytes, size);
+
+			if (written <= 0)
+				return false;
+
+			bytes += written;
+			size -= written;
+		}
+
+		return true;
+	}
+
+	i32 listenOn(const std::string &address)
+	{
+		std::string host{}, port{};
+
+		if (splitTcpAddress(address, host, port))
+		{
+			return tcpSocket(host, port, true, [](i32 fd, const addrinfo &info)
+			{
+				const i32 reuse = 1;
+				setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+				return bind(fd, info.ai_addr, info.ai_addrlen) == 0 && listen(fd, 16) == 0;
+			});
+		}
+
+		sockaddr_un unixAddress;
+		const auto fd = unixSocket(address, unixAddress);
+
+		if (fd < 0)
+			return -1;
+
+		unlink(address.c_str());
+
+		if (bind(fd, reinterpret_cast<const sockaddr *>(&unixAddress), sizeof(unixAddress)) != 0
+			|| listen(fd, 16) != 0)
+		{
+			std::cerr << "failed to listen on " << address << ": " << std::strerror(errno) << std::endl;
+			close(fd);
+			return -1;
+		}
+
+		return fd;
+	}
+
+	i32 connectTo(const std::string &address)
+	{
+		std::string host{}, port{};
+
+		if (splitTcpAddress(address, host, port))
+		{
+			return tcpSocket(host, port, false, [](i32 fd, const addrinfo &info)
+			{
+				if (connect(fd, info.ai_addr, info.ai_addrlen) != 0)
+					return false;
+
+				// requests are single small lines
+				const i32 noDelay = 1;
+				setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+				return true;
+			});
+		}
+
+		sockaddr_un unixAddress;
+		const auto fd = unixSocket(address, unixAddress);
+
+		if (fd < 0)
+			return -1;
+
+		if (connect(fd, reinterpret_cast<const sockaddr *>(&unixAddress), sizeof(unixAddress)) != 0)
+		{
+			std::cerr << "failed to connect to " << address << ": " << std::strerror(errno) << std::endl;
+			close(fd);
+			return -1;
+		}
+
+		return fd;
+	}
+
+	void closeListener(i32 listener, const std::string &address)
+	{
+		close(listener);
+
+		if (!address.starts_with(TcpPrefix))
+			unlink(address.c_str());
+	}
+}
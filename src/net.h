@@ -0,0 +1,45 @@
+#pragma once
+
+#include "types.h"
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+namespace cpurt
+{
+	// buffered line/binary io over a pair of file descriptors. doesn't own them
+	class Connection
+	{
+	public:
+		Connection(i32 in, i32 out)
+			: m_in{in},
+			  m_out{out} {}
+
+		explicit Connection(i32 socket)
+			: Connection{socket, socket} {}
+
+		// without the trailing newline. false on eof or error
+		bool readLine(std::string &line);
+		bool readExact(void *data, std::size_t size);
+
+		bool write(const void *data, std::size_t size);
+
+		inline bool write(std::string_view str)
+		{
+			return write(str.data(), str.size());
+		}
+
+	private:
+		i32 m_in, m_out;
+		std::string m_buffer{};
+	};
+
+	// addresses are unix socket paths, or tcp:<host>:<port> (tcp:<port> to listen on every interface).
+	// both return -1 (after printing why) on failure
+	[[nodiscard]] i32 listenOn(const std::string &address);
+	[[nodiscard]] i32 connectTo(const std::string &address);
+
+	// removes the socket file, for unix sockets
+	void closeListener(i32 listener, const std::string &address);
+}
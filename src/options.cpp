@@ -0,0 +1,370 @@
+#include "options.h"
+
+#include <iostream>
+#include <string_view>
+
+#include "parse.h"
+
+namespace cpurt
+{
+	namespace
+	{
+		constexpr f64 DefaultCheckpointInterval = 60.0;
+
+		void printUsage(const char *name)
+		{
+			std::cerr << "usage: " << name << " [options]\n"
+				<< "  --exposure <stops>         exposure adjustment (default 0)\n"
+				<< "  --tonemap <none|reinhard|aces>\n"
+				<< "  --gamma <gamma>            output gamma (default " << Gamma << ")\n"
+				<< "  --hdr                      also write the linear image as .pfm\n"
+				<< "  --regrade <file.pfm>       post-process an existing render instead of rendering\n"
+				<< "  --progressive              render in passes, periodically writing a preview\n"
+				<< "  --pass-samples <n>         samples per pixel per progressive pass (default 16)\n"
+				<< "  --snapshot-interval <sec>  seconds between previews, 0 to disable (default 10)\n"
+				<< "  --snapshot-passes <n>      passes between previews, 0 to disable (default 0)\n"
+				<< "  --deadline <sec>           stop after this long, keeping the samples taken so far\n"
+				<< "  --budget <sec>             render for this long instead of a fixed number of samples\n"
+				<< "  --preview                  coarse-to-fine preview, starting from a subsampled 1 spp image\n"
+				<< "  --tile-order <row|morton|hilbert|cost>  tile dispatch order (default cost)\n"
+				<< "  --pixel-order <row|morton> pixel order within a tile (default row)\n"
+				<< "  --seed <n>                 render seed (default random)\n"
+				<< "  --checkpoint <file>        periodically save progress to file (implies --progressive)\n"
+				<< "  --checkpoint-interval <sec> seconds between checkpoints (default 60)\n"
+				<< "  --format <png|ppm|pam|qoi> output image format (default png)\n"
+				<< "  --stream                   render in bands, writing each as it finishes\n"
+				<< "  --shared <name|file>       publish tiles to shared memory (/name) or a mapped file as they finish\n"
+				<< "  --shared-format <rgba|linear> pixels of the shared image (default rgba)\n"
+				<< "  --frames <n>               render an n frame orbit around the scene\n"
+				<< "  --serve <socket|->         keep scenes loaded and serve render requests (see server.h)\n"
+				<< "  --distribute <addr,...>    render on --serve processes at these addresses\n"
+				<< "  --shard <tiles|samples>    how --distribute splits the work (default tiles, the only one bit-exact with a local render)\n"
+				<< "  --resume <file>            continue from a checkpoint (implies --progressive)"
+				<< std::endl;
+		}
+
+		bool parseTonemap(std::string_view str, Tonemap &tonemap)
+		{
+			if (str == "none")
+				tonemap = Tonemap::None;
+			else if (str == "reinhard")
+				tonemap = Tonemap::Reinhard;
+			else if (str == "aces")
+				tonemap = Tonemap::Aces;
+			else return false;
+
+			return true;
+		}
+
+		bool parseAddressList(std::string_view str, std::vector<std::string> &addresses)
+		{
+			addresses.clear();
+
+			while (!str.empty())
+			{
+				const auto comma = str.find(',');
+				const auto address = str.substr(0, comma);
+
+				if (address.empty())
+					return false;
+
+				addresses.emplace_back(address);
+
+				if (comma == std::string_view::npos)
+					break;
+
+				str.remove_prefix(comma + 1);
+			}
+
+			return !addresses.empty();
+		}
+
+		bool parseShardMode(std::string_view str, ShardMode &mode)
+		{
+			if (str == "tiles")
+				mode = ShardMode::Tiles;
+			else if (str == "samples")
+				mode = ShardMode::Samples;
+			else return false;
+
+			return true;
+		}
+
+		bool parseImageFormat(std::string_view str, ImageFormat &format)
+		{
+			if (str == "png")
+				format = ImageFormat::Png;
+			else if (str == "ppm")
+				format = ImageFormat::Ppm;
+			else if (str == "pam")
+				format = ImageFormat::Pam;
+			else if (str == "qoi")
+				format = ImageFormat::Qoi;
+			else return false;
+
+			return true;
+		}
+
+		bool parseSharedFormat(std::string_view str, SharedImageFormat &format)
+		{
+			if (str == "rgba")
+				format = SharedImageFormat::Rgba8;
+			else if (str == "linear")
+				format = SharedImageFormat::RgbF32;
+			else return false;
+
+			return true;
+		}
+
+		bool parseTileOrder(std::string_view str, TileOrder &order)
+		{
+			if (str == "row")
+				order = TileOrder::RowMajor;
+			else if (str == "morton")
+				order = TileOrder::Morton;
+			else if (str == "hilbert")
+				order = TileOrder::Hilbert;
+			else if (str == "cost")
+				order = TileOrder::Cost;
+			else return false;
+
+			return true;
+		}
+
+		bool parsePixelOrder(std::string_view str, PixelOrder &order)
+		{
+			if (str == "row")
+				order = PixelOrder::RowMajor;
+			else if (str == "morton")
+				order = PixelOrder::Morton;
+			else return false;
+
+			return true;
+		}
+	}
+
+	std::optional<Options> parseOptions(i32 argc, const char *argv[])
+	{
+		Options options{};
+
+		for (i32 i = 1; i < argc; ++i)
+		{
+			const std::string_view arg{argv[i]};
+
+			// options that take a value
+			const auto next = [&]() -> std::optional<std::string_view>
+			{
+				if (i + 1 >= argc)
+				{
+					std::cerr << "missing value for " << arg << std::endl;
+					return {};
+				}
+
+				return std::string_view{argv[++i]};
+			};
+
+			bool valid = true;
+
+			if (arg == "--hdr")
+				options.writeHdr = true;
+			else if (arg == "--exposure")
+			{
+				const auto value = next();
+				valid = value && parseNumber(*value, options.post.exposure);
+			}
+			else if (arg == "--gamma")
+			{
+				const auto value = next();
+				valid = value && parseNumber(*value, options.post.gamma) && options.post.gamma > 0.0F;
+			}
+			else if (arg == "--tonemap")
+			{
+				const auto value = next();
+				valid = value && parseTonemap(*value, options.post.tonemap);
+			}
+			else if (arg == "--regrade")
+			{
+				const auto value = next();
+
+				if (value)
+					options.regrade = std::string{*value};
+				else valid = false;
+			}
+			else if (arg == "--progressive")
+			{
+				if (!options.progressive)
+					options.progressive = ProgressiveSettings{};
+			}
+			else if (arg == "--pass-samples")
+			{
+				auto &progressive = options.progressive ? *options.progressive : options.progressive.emplace();
+				const auto value = next();
+				valid = value && parseNumber(*value, progressive.passSamples) && progressive.passSamples > 0;
+			}
+			else if (arg == "--snapshot-interval")
+			{
+				auto &progressive = options.progressive ? *options.progressive : options.progressive.emplace();
+				const auto value = next();
+				valid = value && parseNumber(*value, progressive.snapshotInterval);
+			}
+			else if (arg == "--snapshot-passes")
+			{
+				auto &progressive = options.progressive ? *options.progressive : options.progressive.emplace();
+				const auto value = next();
+				valid = value && parseNumber(*value, progressive.snapshotPasses);
+			}
+			else if (arg == "--deadline")
+			{
+				const auto value = next();
+				valid = value && parseNumber(*value, options.deadline.emplace()) && *options.deadline > 0.0;
+			}
+			else if (arg == "--budget")
+			{
+				const auto value = next();
+				valid = value && parseNumber(*value, options.budget.emplace()) && *options.budget > 0.0;
+			}
+			else if (arg == "--preview")
+				options.preview = true;
+			else if (arg == "--tile-order")
+			{
+				const auto value = next();
+				valid = value && parseTileOrder(*value, options.tileOrder);
+			}
+			else if (arg == "--pixel-order")
+			{
+				const auto value = next();
+				valid = value && parsePixelOrder(*value, options.pixelOrder);
+			}
+			else if (arg == "--seed")
+			{
+				const auto value = next();
+				valid = value && parseNumber(*value, options.seed.emplace());
+			}
+			else if (arg == "--checkpoint" || arg == "--resume")
+			{
+				auto &progressive = options.progressive ? *options.progressive : options.progressive.emplace();
+
+				if (progressive.checkpointInterval == 0.0)
+					progressive.checkpointInterval = DefaultCheckpointInterval;
+
+				const auto value = next();
+
+				if (value)
+					(arg == "--checkpoint" ? options.checkpoint : options.resume) = std::string{*value};
+				else valid = false;
+			}
+			else if (arg == "--checkpoint-interval")
+			{
+				auto &progressive = options.progressive ? *options.progressive : options.progressive.emplace();
+				const auto value = next();
+				valid = value && parseNumber(*value, progressive.checkpointInterval);
+			}
+			else if (arg == "--format")
+			{
+				const auto value = next();
+				valid = value && parseImageFormat(*value, options.format);
+			}
+			else if (arg == "--stream")
+				options.stream = true;
+			else if (arg == "--shared")
+			{
+				const auto value = next();
+
+				if (value)
+					options.shared = std::string{*value};
+				else valid = false;
+			}
+			else if (arg == "--shared-format")
+			{
+				const auto value = next();
+				valid = value && parseSharedFormat(*value, options.sharedFormat);
+			}
+			else if (arg == "--frames")
+			{
+				const auto value = next();
+				valid = value && parseNumber(*value, options.frames.emplace()) && *options.frames > 0;
+			}
+			else if (arg == "--serve")
+			{
+				const auto value = next();
+
+				if (value)
+					options.serve = std::string{*value};
+				else valid = false;
+			}
+			else if (arg == "--distribute")
+			{
+				const auto value = next();
+				valid = value && parseAddressList(*value, options.distribute);
+			}
+			else if (arg == "--shard")
+			{
+				const auto value = next();
+				valid = value && parseShardMode(*value, options.shard);
+			}
+			else if (arg == "--help" || arg == "-h")
+				valid = false;
+			else
+			{
+				std::cerr << "unknown option " << arg << std::endl;
+				valid = false;
+			}
+
+			if (!valid)
+			{
+				printUsage(argv[0]);
+				return {};
+			}
+		}
+
+		// resuming keeps checkpointing to the same file unless told otherwise
+		if (options.resume && !options.checkpoint)
+			options.checkpoint = options.resume;
+
+		if (!options.distribute.empty() && (options.progressive || options.frames))
+		{
+			std::cerr << "--distribute can't be combined with progressive or sequence rendering" << std::endl;
+			printUsage(argv[0]);
+			return {};
+		}
+
+		if (options.stream && (options.progressive || options.frames || !options.distribute.empty() || options.writeHdr))
+		{
+			std::cerr << "--stream can't be combined with progressive, sequence, distributed or hdr output" << std::endl;
+			printUsage(argv[0]);
+			return {};
+		}
+
+		if (options.preview && (options.progressive || options.frames || !options.distribute.empty() || options.stream))
+		{
+			std::cerr << "--preview can't be combined with progressive, sequence, distributed or streamed rendering" << std::endl;
+			printUsage(argv[0]);
+			return {};
+		}
+
+		if ((options.deadline || options.budget) && (options.progressive || options.frames || !options.distribute.empty()
+			|| options.stream || options.preview || (options.deadline && options.budget)))
+		{
+			std::cerr << "--deadline and --budget can't be combined with each other, or with progressive,"
+				" sequence, distributed, streamed or preview rendering" << std::endl;
+			printUsage(argv[0]);
+			return {};
+		}
+
+		if (options.shared && (options.frames || options.preview || options.regrade))
+		{
+			std::cerr << "--shared can't be combined with sequence or preview rendering or --regrade" << std::endl;
+			printUsage(argv[0]);
+			return {};
+		}
+
+		if (options.frames && options.progressive)
+		{
+			std::cerr << "--frames can't be combined with progressive rendering" << std::endl;
+			printUsage(argv[0]);
+			return {};
+		}
+
+		return options;
+	}
+}
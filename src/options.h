@@ -0,0 +1,73 @@
+#pragma once
+
+#include "types.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "postprocess.h"
+#include "render.h"
+#include "distribute.h"
+#include "output.h"
+#include "sharedimage.h"
+
+namespace cpurt
+{
+	struct Options
+	{
+		PostSettings post{};
+
+		// also write the linear image as a pfm next to the png
+		bool writeHdr{false};
+
+		// render in passes, writing previews along the way
+		std::optional<ProgressiveSettings> progressive{};
+
+		TileOrder tileOrder{TileOrder::Cost};
+		PixelOrder pixelOrder{PixelOrder::RowMajor};
+
+		// fixed render seed, random if not given
+		std::optional<u32> seed{};
+
+		// periodically save the accumulation state here (implies progressive)
+		std::optional<std::string> checkpoint{};
+
+		// continue from a checkpoint (implies progressive)
+		std::optional<std::string> resume{};
+
+		ImageFormat format{ImageFormat::Png};
+
+		// render in bands straight into the output file, without ever holding the whole image
+		bool stream{false};
+
+		// stop rendering after this many seconds, keeping whatever samples were taken by then
+		std::optional<f64> deadline{};
+
+		// render for this many seconds, picking the number of samples to fit
+		std::optional<f64> budget{};
+
+		// coarse-to-fine interactive preview of the still camera, rewriting one preview file
+		bool preview{false};
+
+		// also publish tiles into this shared memory object or file as they finish
+		std::optional<std::string> shared{};
+		SharedImageFormat sharedFormat{SharedImageFormat::Rgba8};
+
+		// render an orbit around the scene, one png per frame
+		std::optional<u32> frames{};
+
+		// render on these servers instead of locally
+		std::vector<std::string> distribute{};
+		ShardMode shard{ShardMode::Tiles};
+
+		// serve render requests on this unix socket, or stdin/stdout for "-"
+		std::optional<std::string> serve{};
+
+		// skip rendering, and only post-process an existing pfm
+		std::optional<std::string> regrade{};
+	};
+
+	// prints usage and returns nothing on invalid arguments
+	[[nodiscard]] std::optional<Options> parseOptions(i32 argc, const char *argv[]);
+}
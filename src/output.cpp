@@ -0,0 +1,599 @@
+#include "output.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <ctime>
+#include <bit>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#include "deflate.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "3rdparty/stb_image_write.h"
+
+namespace cpurt
+{
+	namespace
+	{
+		constexpr bool LittleEndian = std::endian::native == std::endian::little;
+
+		inline u32 byteswap(u32 v)
+		{
+			return ((v & 0xFF) << 24) | ((v & 0xFF00) << 8) | ((v >> 8) & 0xFF00) | (v >> 24);
+		}
+
+		inline void appendBigEndian(std::vector<u8> &out, u32 v)
+		{
+			out.insert(out.end(), {
+				static_cast<u8>(v >> 24), static_cast<u8>(v >> 16),
+				static_cast<u8>(v >> 8), static_cast<u8>(v)
+			});
+		}
+
+		constexpr u8 PngSignature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+		// deflate with a 32k window, fastest compression level
+		constexpr u8 ZlibHeader[] = {0x78, 0x01};
+
+		constexpr u32 PngFilterCount = 5;
+
+		// uncompressed size of the bands compressed in parallel, big enough
+		// that restarting the match window every band costs little
+		constexpr std::size_t PngBandBytes = 256 * 1024;
+
+		constexpr u8 QoiEnd[] = {0, 0, 0, 0, 0, 0, 0, 1};
+		constexpr u32 QoiMaxRun = 62;
+
+		void appendChunk(std::vector<u8> &out, const char *type, std::span<const u8> data)
+		{
+			const std::span<const u8> typeBytes{reinterpret_cast<const u8 *>(type), 4};
+
+			appendBigEndian(out, static_cast<u32>(data.size()));
+			out.insert(out.end(), typeBytes.begin(), typeBytes.end());
+			out.insert(out.end(), data.begin(), data.end());
+			appendBigEndian(out, deflate::crc32(data, deflate::crc32(typeBytes)));
+		}
+
+		// the checksum that ends the zlib stream, in its own data chunk
+		void appendPngEnd(std::vector<u8> &out, u32 adler)
+		{
+			std::vector<u8> checksum{};
+			appendBigEndian(checksum, adler);
+
+			appendChunk(out, "IDAT", checksum);
+			appendChunk(out, "IEND", {});
+		}
+
+		inline void appendRgb(std::vector<u8> &out, const u32 *data, std::size_t count)
+		{
+			const auto start = out.size();
+			out.resize(start + count * 3);
+
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				out[start + i * 3 + 0] = static_cast<u8>(data[i]);
+				out[start + i * 3 + 1] = static_cast<u8>(data[i] >> 8);
+				out[start + i * 3 + 2] = static_cast<u8>(data[i] >> 16);
+			}
+		}
+
+		inline u8 paeth(i32 a, i32 b, i32 c)
+		{
+			const auto p = a + b - c;
+
+			const auto pa = std::abs(p - a);
+			const auto pb = std::abs(p - b);
+			const auto pc = std::abs(p - c);
+
+			return static_cast<u8>(pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+		}
+
+		// byte i of an rgb row, filtered against the bytes left of and above it
+		inline u8 pngFilter(u32 filter, const u8 *row, const u8 *above, u32 i)
+		{
+			const i32 a = i >= 3 ? row[i - 3] : 0;
+			const i32 b = above[i];
+			const i32 c = i >= 3 ? above[i - 3] : 0;
+
+			switch (filter)
+			{
+				case 1: return static_cast<u8>(row[i] - a);
+				case 2: return static_cast<u8>(row[i] - b);
+				case 3: return static_cast<u8>(row[i] - (a + b) / 2);
+				case 4: return static_cast<u8>(row[i] - paeth(a, b, c));
+				default: return row[i];
+			}
+		}
+
+		void filterRow(u32 rowBytes, const u8 *row, const u8 *above, std::vector<u8> &out)
+		{
+			// same heuristic as most encoders, the filter with the smallest sum of signed residuals
+			u32 bestFilter = 0;
+			u64 bestScore = ~u64{};
+
+			for (u32 filter = 0; filter < PngFilterCount; ++filter)
+			{
+				u64 score = 0;
+
+				for (u32 i = 0; i < rowBytes; ++i)
+				{
+					score += static_cast<u64>(std::abs(static_cast<i8>(pngFilter(filter, row, above, i))));
+				}
+
+				if (score < bestScore)
+				{
+					bestScore = score;
+					bestFilter = filter;
+				}
+			}
+
+			out.push_back(static_cast<u8>(bestFilter));
+
+			for (u32 i = 0; i < rowBytes; ++i)
+			{
+				out.push_back(pngFilter(bestFilter, row, above, i));
+			}
+		}
+
+		// a run of png rows as one data chunk holding an independent piece of the zlib stream
+		struct PngBand
+		{
+			std::vector<u8> chunk{};
+
+			// of the uncompressed piece, for combining into the whole stream's checksum
+			u32 adler{};
+			std::size_t size{};
+		};
+
+		// above is the row before the first one, or null at the top of the image
+		void encodePngBand(u32 width, const u32 *data, u32 rows, const u32 *above, bool last, PngBand &band)
+		{
+			const auto rowBytes = width * 3;
+
+			// rgb rows, with the row above (or zeros) in front
+			std::vector<u8> pixels{};
+			pixels.reserve(static_cast<std::size_t>(rows + 1) * rowBytes);
+
+			if (above)
+				appendRgb(pixels, above, width);
+			else pixels.resize(rowBytes);
+
+			appendRgb(pixels, data, static_cast<std::size_t>(rows) * width);
+
+			std::vector<u8> filtered{};
+			filtered.reserve(static_cast<std::size_t>(rows) * (rowBytes + 1));
+
+			for (u32 y = 0; y < rows; ++y)
+			{
+				const auto *row = &pixels[static_cast<std::size_t>(y + 1) * rowBytes];
+				filterRow(rowBytes, row, row - rowBytes, filtered);
+			}
+
+			band.adler = deflate::adler32(filtered);
+			band.size = filtered.size();
+
+			std::vector<u8> compressed{};
+
+			if (!above)
+				compressed.insert(compressed.end(), std::begin(ZlibHeader), std::end(ZlibHeader));
+
+			deflate::compress(filtered, last, compressed);
+
+			band.chunk.clear();
+			appendChunk(band.chunk, "IDAT", compressed);
+		}
+
+		inline u32 qoiHash(u32 pixel)
+		{
+			const auto r = pixel & 0xFF;
+			const auto g = (pixel >> 8) & 0xFF;
+			const auto b = (pixel >> 16) & 0xFF;
+			const auto a = pixel >> 24;
+
+			return (r * 3 + g * 5 + b * 7 + a * 11) % 64;
+		}
+	}
+
+	std::string_view extension(ImageFormat format)
+	{
+		switch (format)
+		{
+			case ImageFormat::Ppm: return "ppm";
+			case ImageFormat::Pam: return "pam";
+			case ImageFormat::Qoi: return "qoi";
+			default: return "png";
+		}
+	}
+
+	std::string timestampFilename(std::string_view extension)
+	{
+		const auto time = std::time(nullptr);
+		const auto *tm = std::localtime(&time);
+
+		std::ostringstream filename{};
+		filename << std::put_time(tm, "%Y-%m-%d_%H.%M.%S") << '.' << extension;
+
+		return filename.str();
+	}
+
+	bool writePng(const std::string &filename, u32 width, u32 height, const u32 *data)
+	{
+		return stbi_write_png(filename.c_str(),
+			static_cast<i32>(width), static_cast<i32>(height),
+			4, data, static_cast<i32>(width * sizeof(u32))) != 0;
+	}
+
+	bool encodePng(u32 width, u32 height, const u32 *data, std::vector<u8> &out)
+	{
+		out.clear();
+
+		return stbi_write_png_to_func([](void *context, void *bytes, i32 size)
+		{
+			auto &buffer = *static_cast<std::vector<u8> *>(context);
+			const auto *begin = static_cast<const u8 *>(bytes);
+
+			buffer.insert(buffer.end(), begin, begin + size);
+		}, &out, static_cast<i32>(width), static_cast<i32>(height),
+			4, data, static_cast<i32>(width * sizeof(u32))) != 0;
+	}
+
+	ImageEncoder::ImageEncoder(ImageFormat format, u32 width, u32 height, std::vector<u8> &out)
+		: m_format{format},
+		  m_width{width},
+		  m_height{height}
+	{
+		const auto appendText = [&out](const std::string &text)
+		{
+			out.insert(out.end(), text.begin(), text.end());
+		};
+
+		switch (format)
+		{
+			case ImageFormat::Png:
+			{
+				out.insert(out.end(), std::begin(PngSignature), std::end(PngSignature));
+
+				std::vector<u8> header{};
+
+				appendBigEndian(header, width);
+				appendBigEndian(header, height);
+
+				// 8 bit rgb, deflate, adaptive filtering, not interlaced
+				header.insert(header.end(), {8, 2, 0, 0, 0});
+
+				appendChunk(out, "IHDR", header);
+				break;
+			}
+			case ImageFormat::Ppm:
+				appendText("P6\n" + std::to_string(width) + ' ' + std::to_string(height) + "\n255\n");
+				break;
+			case ImageFormat::Pam:
+				appendText("P7\nWIDTH " + std::to_string(width) + "\nHEIGHT " + std::to_string(height)
+					+ "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n");
+				break;
+			case ImageFormat::Qoi:
+				appendText("qoif");
+				appendBigEndian(out, width);
+				appendBigEndian(out, height);
+
+				// rgb, srgb
+				out.insert(out.end(), {3, 0});
+				break;
+			default:
+				break;
+		}
+	}
+
+	bool ImageEncoder::encode(const u32 *data, u32 rows, std::vector<u8> &out)
+	{
+		if (rows > m_height - m_rows)
+		{
+			std::cerr << "image encoder got " << (m_rows + rows) << " rows, expected " << m_height << std::endl;
+			return false;
+		}
+
+		const auto count = static_cast<std::size_t>(rows) * m_width;
+
+		switch (m_format)
+		{
+			case ImageFormat::Png:
+			{
+				PngBand band{};
+				encodePngBand(m_width, data, rows, m_rows > 0 ? m_previousRow.data() : nullptr,
+					m_rows + rows == m_height, band);
+
+				out.insert(out.end(), band.chunk.begin(), band.chunk.end());
+				m_adler = deflate::adler32Combine(m_adler, band.adler, band.size);
+
+				if (rows > 0)
+					m_previousRow.assign(data + count - m_width, data + count);
+
+				break;
+			}
+			case ImageFormat::Ppm:
+				appendRgb(out, data, count);
+				break;
+			case ImageFormat::Pam:
+			{
+				const auto start = out.size();
+				out.resize(start + count * sizeof(u32));
+
+				if constexpr(LittleEndian)
+					std::memcpy(&out[start], data, count * sizeof(u32));
+				else
+				{
+					for (std::size_t i = 0; i < count; ++i)
+					{
+						const auto pixel = byteswap(data[i]);
+						std::memcpy(&out[start + i * sizeof(u32)], &pixel, sizeof(u32));
+					}
+				}
+
+				break;
+			}
+			case ImageFormat::Qoi:
+				for (std::size_t i = 0; i < count; ++i)
+				{
+					const auto pixel = data[i];
+
+					if (pixel == m_qoiPrevious)
+					{
+						if (++m_qoiRun == QoiMaxRun)
+						{
+							out.push_back(static_cast<u8>(0xC0 | (m_qoiRun - 1)));
+							m_qoiRun = 0;
+						}
+
+						continue;
+					}
+
+					if (m_qoiRun > 0)
+					{
+						out.push_back(static_cast<u8>(0xC0 | (m_qoiRun - 1)));
+						m_qoiRun = 0;
+					}
+
+					const auto hash = qoiHash(pixel);
+
+					if (m_qoiIndex[hash] == pixel)
+						out.push_back(static_cast<u8>(hash));
+					else
+					{
+						m_qoiIndex[hash] = pixel;
+
+						const auto delta = [&](u32 shift)
+						{
+							return static_cast<i32>(static_cast<i8>(static_cast<u8>((pixel >> shift) - (m_qoiPrevious >> shift))));
+						};
+
+						const auto dr = delta(0);
+						const auto dg = delta(8);
+						const auto db = delta(16);
+
+						if ((pixel >> 24) != (m_qoiPrevious >> 24))
+						{
+							out.insert(out.end(), {
+								0xFF, static_cast<u8>(pixel), static_cast<u8>(pixel >> 8),
+								static_cast<u8>(pixel >> 16), static_cast<u8>(pixel >> 24)
+							});
+						}
+						else if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+							out.push_back(static_cast<u8>(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+						else if (dg >= -32 && dg <= 31 && dr - dg >= -8 && dr - dg <= 7 && db - dg >= -8 && db - dg <= 7)
+						{
+							out.push_back(static_cast<u8>(0x80 | (dg + 32)));
+							out.push_back(static_cast<u8>((dr - dg + 8) << 4 | (db - dg + 8)));
+						}
+						else out.insert(out.end(), {0xFE, static_cast<u8>(pixel), static_cast<u8>(pixel >> 8), static_cast<u8>(pixel >> 16)});
+					}
+
+					m_qoiPrevious = pixel;
+				}
+
+				break;
+			default:
+				break;
+		}
+
+		m_rows += rows;
+
+		return true;
+	}
+
+	bool ImageEncoder::finish(std::vector<u8> &out)
+	{
+		if (m_rows != m_height)
+		{
+			std::cerr << "image encoder finished after " << m_rows << " of " << m_height << " rows" << std::endl;
+			return false;
+		}
+
+		if (m_format == ImageFormat::Png)
+			appendPngEnd(out, m_adler);
+		else if (m_format == ImageFormat::Qoi)
+		{
+			if (m_qoiRun > 0)
+				out.push_back(static_cast<u8>(0xC0 | (m_qoiRun - 1)));
+
+			m_qoiRun = 0;
+
+			out.insert(out.end(), std::begin(QoiEnd), std::end(QoiEnd));
+		}
+
+		return true;
+	}
+
+	bool encodeImage(ImageFormat format, u32 width, u32 height, const u32 *data, std::vector<u8> &out, Scheduler *pool)
+	{
+		out.clear();
+
+		ImageEncoder encoder{format, width, height, out};
+
+		if (format != ImageFormat::Png || !pool || height == 0)
+			return encoder.encode(data, height, out) && encoder.finish(out);
+
+		const auto bandRows = static_cast<u32>(std::max<std::size_t>(PngBandBytes / (width * 3 + 1), 1));
+		const auto bandCount = (height + bandRows - 1) / bandRows;
+
+		std::vector<PngBand> bands(bandCount);
+
+		pool->run(bandCount, [&](u32 idx)
+		{
+			const auto y = idx * bandRows;
+			const auto *rows = data + static_cast<std::size_t>(y) * width;
+
+			encodePngBand(width, rows, std::min(bandRows, height - y),
+				idx > 0 ? rows - width : nullptr, idx + 1 == bandCount, bands[idx]);
+		});
+
+		u32 adler = 1;
+
+		for (const auto &band : bands)
+		{
+			out.insert(out.end(), band.chunk.begin(), band.chunk.end());
+			adler = deflate::adler32Combine(adler, band.adler, band.size);
+		}
+
+		appendPngEnd(out, adler);
+
+		return true;
+	}
+
+	bool writeFile(const std::string &filename, std::span<const u8> data)
+	{
+		std::ofstream stream{filename, std::ios::binary};
+
+		stream.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+
+		return static_cast<bool>(stream);
+	}
+
+	bool ImageStream::open(const std::string &filename, ImageFormat format, u32 width, u32 height)
+	{
+		m_stream.open(filename, std::ios::binary);
+
+		if (!m_stream)
+		{
+			std::cerr << "failed to open " << filename << std::endl;
+			return false;
+		}
+
+		m_buffer.clear();
+		m_encoder.emplace(format, width, height, m_buffer);
+
+		return flush();
+	}
+
+	bool ImageStream::write(const u32 *data, u32 rows)
+	{
+		return m_encoder->encode(data, rows, m_buffer) && flush();
+	}
+
+	bool ImageStream::close()
+	{
+		if (!m_encoder->finish(m_buffer) || !flush())
+			return false;
+
+		m_stream.close();
+
+		return !m_stream.fail();
+	}
+
+	bool ImageStream::flush()
+	{
+		m_stream.write(reinterpret_cast<const char *>(m_buffer.data()), static_cast<std::streamsize>(m_buffer.size()));
+		m_buffer.clear();
+
+		return static_cast<bool>(m_stream);
+	}
+
+	bool writePfm(const std::string &filename, const HdrImage &image)
+	{
+		std::ofstream stream{filename, std::ios::binary};
+
+		if (!stream)
+			return false;
+
+		// negative scale marks little endian data
+		stream << "PF\n" << image.width << ' ' << image.height << '\n' << (LittleEndian ? "-1.0" : "1.0") << '\n';
+
+		for (u32 y = image.height; y-- > 0;)
+		{
+			stream.write(reinterpret_cast<const char *>(&image.pixels[static_cast<std::size_t>(y) * image.width]),
+				static_cast<std::streamsize>(image.width * sizeof(glm::vec3)));
+		}
+
+		return static_cast<bool>(stream);
+	}
+
+	bool readPfm(const std::string &filename, HdrImage &image)
+	{
+		std::ifstream stream{filename, std::ios::binary};
+
+		if (!stream)
+		{
+			std::cerr << "failed to open " << filename << std::endl;
+			return false;
+		}
+
+		std::string magic{};
+		u32 width, height;
+		f32 scale;
+
+		stream >> magic >> width >> height >> scale;
+
+		if (!stream || magic != "PF")
+		{
+			std::cerr << filename << " is not an rgb pfm file" << std::endl;
+			return false;
+		}
+
+		// exactly one whitespace character separates the header from the data
+		stream.get();
+
+		// checked against what's actually there before allocating anything
+		const auto dataStart = stream.tellg();
+		stream.seekg(0, std::ios::end);
+		const auto dataSize = static_cast<u64>(stream.tellg() - dataStart);
+		stream.seekg(dataStart);
+
+		const auto rowSize = static_cast<std::size_t>(width) * sizeof(glm::vec3);
+
+		if (!stream || width == 0 || height == 0 || static_cast<u64>(rowSize) * height > dataSize)
+		{
+			std::cerr << filename << " is truncated or has invalid dimensions" << std::endl;
+			return false;
+		}
+
+		image.resize(width, height);
+
+		for (u32 y = height; y-- > 0;)
+		{
+			stream.read(reinterpret_cast<char *>(&image.pixels[static_cast<std::size_t>(y) * width]),
+				static_cast<std::streamsize>(rowSize));
+		}
+
+		if (!stream)
+		{
+			std::cerr << "unexpected end of file in " << filename << std::endl;
+			return false;
+		}
+
+		if ((scale < 0.0F) != LittleEndian)
+		{
+			for (auto &pixel : image.pixels)
+			{
+				for (i32 i = 0; i < 3; ++i)
+				{
+					pixel[i] = std::bit_cast<f32>(byteswap(std::bit_cast<u32>(pixel[i])));
+				}
+			}
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "types.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <array>
+#include <span>
+#include <optional>
+
+#include "framebuffer.h"
+#include "scheduler.h"
+
+namespace cpurt
+{
+	// yyyy-mm-dd_hh.mm.ss.<extension>, local time
+	[[nodiscard]] std::string timestampFilename(std::string_view extension);
+
+	bool writePng(const std::string &filename, u32 width, u32 height, const u32 *data);
+	bool encodePng(u32 width, u32 height, const u32 *data, std::vector<u8> &out);
+
+	enum class ImageFormat : u32
+	{
+		// compressed in bands, in parallel when given a pool
+		Png = 0,
+		// uncompressed 8 bit rgb
+		Ppm,
+		// uncompressed 8 bit rgba, the same bytes as the resolved pixels
+		Pam,
+		// fast lossless compression, one pass over the pixels
+		Qoi,
+		_last
+	};
+
+	[[nodiscard]] std::string_view extension(ImageFormat format);
+
+	// encodes an image top to bottom as its rows arrive, appending to a buffer that
+	// the caller can drain in between. pngs are compressed one call at a time
+	class ImageEncoder
+	{
+	public:
+		// appends the header
+		ImageEncoder(ImageFormat format, u32 width, u32 height, std::vector<u8> &out);
+		~ImageEncoder() = default;
+
+		// appends rows of rgba pixels, alpha is dropped except for pam
+		bool encode(const u32 *data, u32 rows, std::vector<u8> &out);
+
+		// only succeeds once every row has been encoded
+		bool finish(std::vector<u8> &out);
+
+	private:
+		ImageFormat m_format;
+		u32 m_width, m_height;
+		u32 m_rows{};
+
+		// last row so far, png rows are filtered against the row above
+		std::vector<u32> m_previousRow{};
+
+		// running checksum of the uncompressed png data
+		u32 m_adler{1};
+
+		// qoi state carried from one row to the next
+		std::array<u32, 64> m_qoiIndex{};
+		u32 m_qoiPrevious{0xFF000000};
+		u32 m_qoiRun{};
+	};
+
+	// encodes a whole image. png bands are compressed on the pool's threads if there is
+	// one, which must not be running anything else. bands don't share matches, which
+	// costs a little compression
+	bool encodeImage(ImageFormat format, u32 width, u32 height, const u32 *data,
+		std::vector<u8> &out, Scheduler *pool = nullptr);
+
+	bool writeFile(const std::string &filename, std::span<const u8> data);
+
+	// writes an image to disk as its rows arrive, never holding more than the rows of a single write
+	class ImageStream
+	{
+	public:
+		ImageStream() = default;
+		~ImageStream() = default;
+
+		ImageStream(const ImageStream &) = delete;
+		ImageStream &operator=(const ImageStream &) = delete;
+
+		bool open(const std::string &filename, ImageFormat format, u32 width, u32 height);
+		bool write(const u32 *data, u32 rows);
+		bool close();
+
+	private:
+		std::ofstream m_stream{};
+		std::optional<ImageEncoder> m_encoder{};
+
+		std::vector<u8> m_buffer{};
+
+		bool flush();
+	};
+
+	// portable float map - uncompressed 32-bit float rgb, bottom-to-top rows
+	bool writePfm(const std::string &filename, const HdrImage &image);
+	bool readPfm(const std::string &filename, HdrImage &image);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "types.h"
+
+#include <string_view>
+#include <charconv>
+
+namespace cpurt
+{
+	// the whole string has to be the number, with nothing before or after it
+	template <typename T>
+	[[nodiscard]] inline bool parseNumber(std::string_view str, T &value)
+	{
+		const auto *end = str.data() + str.size();
+		const auto [ptr, err] = std::from_chars(str.data(), end, value);
+		return err == std::errc{} && ptr == end;
+	}
+}
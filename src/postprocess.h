@@ -0,0 +1,58 @@
+#pragma once
+
+#include "types.h"
+
+#include <glm/glm.hpp>
+
+#include "config.h"
+
+namespace cpurt
+{
+	enum class Tonemap : u32
+	{
+		None = 0,
+		Reinhard,
+		Aces,
+		_last
+	};
+
+	struct PostSettings
+	{
+		f32 exposure{0.0F}; // stops
+		Tonemap tonemap{Tonemap::None};
+		f32 gamma{Gamma};
+	};
+
+	inline u32 toColor(glm::vec3 rgb)
+	{
+		rgb = glm::clamp(rgb, 0.0F, 1.0F);
+		return 0xFF000000
+			| (static_cast<u32>(rgb.r * 255.0F) <<  0)
+			| (static_cast<u32>(rgb.g * 255.0F) <<  8)
+			| (static_cast<u32>(rgb.b * 255.0F) << 16);
+	}
+
+	inline u32 developPixel(glm::vec3 color, const PostSettings &settings, f32 exposureScale)
+	{
+		color = glm::max(color * exposureScale, glm::vec3{});
+
+		switch (settings.tonemap)
+		{
+		case Tonemap::Reinhard:
+			color = color / (1.0F + color);
+			break;
+
+		case Tonemap::Aces: // narkowicz's fit
+			color = glm::clamp((color * (2.51F * color + 0.03F)) / (color * (2.43F * color + 0.59F) + 0.14F), 0.0F, 1.0F);
+			break;
+
+		default:
+			break;
+		}
+
+		if (settings.gamma != 1.0F)
+			color = glm::pow(color, glm::vec3{1.0F / settings.gamma});
+
+		return toColor(color);
+	}
+}
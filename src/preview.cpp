@@ -0,0 +1,85 @@
+#include "preview.h"
+
+namespace cpurt
+{
+	PreviewSession::PreviewSession(Renderer &renderer, const Scene &scene, const PreviewSettings &settings, PreviewOutput output)
+		: m_renderer{renderer},
+		  m_scene{scene},
+		  m_settings{settings},
+		  m_output{std::move(output)}
+	{
+		m_thread = std::thread{&PreviewSession::run, this};
+	}
+
+	PreviewSession::~PreviewSession()
+	{
+		{
+			std::scoped_lock lock{m_mutex};
+
+			m_exit = true;
+			m_cancel.store(true, std::memory_order::relaxed);
+		}
+
+		m_condition.notify_all();
+		m_thread.join();
+	}
+
+	void PreviewSession::setCamera(const Camera &camera)
+	{
+		{
+			std::scoped_lock lock{m_mutex};
+
+			m_camera = camera;
+			++m_generation;
+
+			// set under the lock, so it can't be cleared for the old camera after this
+			m_cancel.store(true, std::memory_order::relaxed);
+		}
+
+		m_condition.notify_all();
+	}
+
+	void PreviewSession::wait()
+	{
+		std::unique_lock lock{m_mutex};
+
+		m_condition.wait(lock, [this]
+		{
+			return m_finished == m_generation;
+		});
+	}
+
+	void PreviewSession::run()
+	{
+		std::unique_lock lock{m_mutex};
+
+		while (true)
+		{
+			m_condition.wait(lock, [this]
+			{
+				return m_exit || m_camera;
+			});
+
+			if (m_exit)
+				return;
+
+			const auto camera = *m_camera;
+			const auto generation = m_generation;
+
+			m_camera.reset();
+			m_cancel.store(false, std::memory_order::relaxed);
+
+			lock.unlock();
+
+			const auto finished = m_renderer.drawPreview(m_scene, camera, m_settings, m_output, &m_cancel);
+
+			lock.lock();
+
+			if (finished)
+			{
+				m_finished = generation;
+				m_condition.notify_all();
+			}
+		}
+	}
+}
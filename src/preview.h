@@ -0,0 +1,56 @@
+#pragma once
+
+#include "types.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <optional>
+
+#include "render.h"
+
+namespace cpurt
+{
+	// interactive previews on a thread of their own. every new camera cancels the
+	// preview in flight and starts over from the coarsest image
+	class PreviewSession
+	{
+	public:
+		// the renderer and scene must outlive the session, and the renderer
+		// mustn't be used for anything else meanwhile
+		PreviewSession(Renderer &renderer, const Scene &scene, const PreviewSettings &settings, PreviewOutput output);
+		~PreviewSession();
+
+		PreviewSession(const PreviewSession &) = delete;
+		PreviewSession &operator=(const PreviewSession &) = delete;
+
+		void setCamera(const Camera &camera);
+
+		// blocks until the latest camera's preview has all its samples
+		void wait();
+
+	private:
+		void run();
+
+		Renderer &m_renderer;
+		const Scene &m_scene;
+
+		PreviewSettings m_settings;
+		PreviewOutput m_output;
+
+		std::mutex m_mutex{};
+		std::condition_variable m_condition{};
+
+		// waiting to be picked up by the preview thread
+		std::optional<Camera> m_camera{};
+
+		u64 m_generation{};
+		u64 m_finished{};
+		bool m_exit{false};
+
+		std::atomic<bool> m_cancel{false};
+
+		std::thread m_thread{};
+	};
+}
@@ -2,10 +2,18 @@
 
 #include <limits>
 #include <iostream>
+#include <algorithm>
+#include <bit>
+#include <array>
+#include <future>
+#include <chrono>
+#include <utility>
 
 #include "config.h"
 #include "ray.h"
 #include "timer.h"
+#include "curves.h"
+#include "simd.h"
 
 namespace cpurt
 {
@@ -13,41 +21,92 @@ namespace cpurt
 	{
 		constexpr auto ScatterEpsilon = 0.000000001F;
 
-		const auto Gamma3 = glm::vec3{Gamma};
-		const auto InvGamma = 1.0F / Gamma3;
+		inline f32 schlick(f32 cosTheta, f32 refractiveIndex)
+		{
+			auto r0 = (1.0F - refractiveIndex) / (1.0F + refractiveIndex);
+			r0 *= r0;
+			return r0 + (1.0F - r0) * glm::pow(1.0F - cosTheta, 5.0F);
+		}
+
+		// lowest and highest samples per pixel
+		std::pair<u32, u32> sampleRange(const Framebuffer &framebuffer)
+		{
+			if (framebuffer.samples.empty())
+				return {0, 0};
 
-		constexpr bool Tonemap = false;
-		constexpr bool GammaCorrect = true;
+			const auto [min, max] = std::minmax_element(framebuffer.samples.begin(), framebuffer.samples.end());
+			return {*min, *max};
+		}
+
+		struct FirstHit
+		{
+			glm::vec3 albedo;
+			glm::vec3 normal;
+			f32 depth;
+		};
+
+		// depth stored for paths that hit nothing
+		constexpr f32 MissDepth = 1.0e6F;
 
-		inline u32 toColor(glm::vec3 rgb)
+		// guide features are taken from the first vertex that is not a near-perfect
+		// mirror or glass, so reflections and refractions survive denoising
+		constexpr f32 SpecularRoughness = 0.25F;
+
+		inline bool isSpecular(const Material &material)
 		{
-			rgb = glm::clamp(rgb, 0.0F, 1.0F);
-			return 0xFF000000
-				| (static_cast<u32>(rgb.r * 255.0F) <<  0)
-				| (static_cast<u32>(rgb.g * 255.0F) <<  8)
-				| (static_cast<u32>(rgb.b * 255.0F) << 16);
+			return material.type == MaterialType::Dielectric
+				|| (material.type == MaterialType::Metal && material.metal.roughness < SpecularRoughness);
 		}
 
-		inline f32 schlick(f32 cosTheta, f32 refractiveIndex)
+		inline glm::vec3 featureAlbedo(const Material &material)
 		{
-			auto r0 = (1.0F - refractiveIndex) / (1.0F + refractiveIndex);
-			r0 *= r0;
-			return r0 + (1.0F - r0) * glm::pow(1.0F - cosTheta, 5.0F);
+			switch (material.type)
+			{
+			case MaterialType::Diffuse: return material.diffuse.albedo;
+			case MaterialType::Metal: return material.metal.albedo;
+			case MaterialType::Dielectric: return material.dielectric.color;
+			case MaterialType::Light: return glm::clamp(material.light.emitted, 0.0F, 1.0F);
+			}
+
+			return glm::vec3{};
 		}
 
-		glm::vec3 trace(const Scene &scene, const Ray &initial, Rng &rng)
+		// adds the number of rays traced (the path's segments) to rays
+		CPURT_KERNEL glm::vec3 trace(const Scene &scene, const Ray &initial, u32 bounces, SampleRng &rng,
+			FirstHit &firstHit, u64 &rays)
 		{
 			glm::vec3 color{1.0F};
 
 			TraceResult result{};
 			Ray ray{initial};
 
-			for (u32 i = 0; i <= Bounces; ++i)
+			bool featuresPending = Denoise;
+			f32 pathLength = 0.0F;
+
+			if constexpr(Denoise)
+				firstHit = {
+					.albedo = glm::vec3{},
+					.normal = glm::vec3{},
+					.depth = MissDepth
+				};
+
+			for (u32 i = 0; i <= bounces; ++i)
 			{
 				scene.traceRay(result, ray);
+				++rays;
 
 				if (!result.hitMaterial)
 				{
+					if constexpr(Denoise)
+					{
+						if (featuresPending)
+							firstHit = {
+								.albedo = color * result.missColor,
+								.normal = glm::vec3{},
+								.depth = MissDepth
+							};
+					}
+
 					color *= result.missColor;
 					break;
 				}
@@ -61,10 +120,26 @@ namespace cpurt
 					normal = -normal;
 				}
 
-				ray.origin = result.hitPos;
-
 				const auto &material = *result.hitMaterial;
 
+				if constexpr(Denoise)
+				{
+					pathLength += glm::length(result.hitPos - ray.origin);
+
+					if (featuresPending && (!isSpecular(material) || i == bounces))
+					{
+						firstHit = {
+							.albedo = color * featureAlbedo(material),
+							.normal = normal,
+							.depth = pathLength
+						};
+
+						featuresPending = false;
+					}
+				}
+
+				ray.origin = result.hitPos;
+
 				bool bounce = true;
 
 				switch (material.type)
@@ -131,148 +206,1114 @@ namespace cpurt
 		}
 	}
 
-	Renderer::Renderer(const Scene &scene)
-		: m_scene{scene} {}
+	namespace
+	{
+		// probe paths per tile for TileOrder::Cost
+		constexpr u32 CostProbes = 4;
+
+		// split tiles when the scheduler runs low on work
+		constexpr bool SplitTiles = true;
+		constexpr u32 MinSplitSize = 4;
+		constexpr u32 SpareTasksPerThread = 64;
+
+		// tiles per thread in each batch handed to the pool. other jobs sharing
+		// the pool can get their turn whenever one of these finishes
+		constexpr u32 SliceTilesPerThread = 16;
+
+		// visits every pixel of a tile in the given order
+		template <typename F>
+		inline void forEachPixel(PixelOrder order, u32 startX, u32 endX, u32 startY, u32 endY, F &&func)
+		{
+			if (order == PixelOrder::Morton)
+			{
+				const auto width = endX - startX;
+				const auto height = endY - startY;
+
+				// codes covering the enclosing power-of-two square, skipping those outside the tile
+				const auto side = std::bit_ceil(std::max(width, height));
+
+				for (u32 code = 0; code < side * side; ++code)
+				{
+					u32 x, y;
+					curves::mortonDecode(code, x, y);
+
+					if (x < width && y < height)
+						func(startX + x, startY + y);
+				}
+
+				return;
+			}
+
+			for (u32 y = startY; y < endY; ++y)
+			{
+				for (u32 x = startX; x < endX; ++x)
+				{
+					func(x, y);
+				}
+			}
+		}
+
+		u32 threadCount()
+		{
+			const u32 threadCount = Threads == 0 ? std::thread::hardware_concurrency() : Threads;
+
+			std::cout << "launching " << threadCount << " threads" << std::endl;
+
+			return threadCount;
+		}
+
+		// one pool for the whole process, however many renderers there are
+		Scheduler &sharedScheduler()
+		{
+			static Scheduler scheduler = []
+			{
+				std::cout << "kernels: " << simd::kernelIsa() << std::endl;
+
+				const auto threads = threadCount();
+				auto cpus = PinThreads ? availableCpus() : std::vector<CpuInfo>{};
+
+				if (!cpus.empty())
+				{
+					const auto pinned = std::min(static_cast<u32>(cpus.size()), threads);
+
+					std::cout << "pinned to " << pinned << " cpus on "
+						<< nodeCount(std::span{cpus}.first(pinned)) << " numa nodes" << std::endl;
+				}
+
+				return Scheduler{threads, std::move(cpus)};
+			}();
+
+			return scheduler;
+		}
+	}
+
+	Renderer::Renderer(std::string name, i32 priority)
+		: m_name{std::move(name)},
+		  m_scheduler{sharedScheduler()},
+		  m_job{m_scheduler.addJob(m_name, priority)}
+	{
+		for (u32 i = 0; i < m_scheduler.threadCount(); ++i)
+		{
+			if (m_scheduler.cpu(i))
+				m_nodeCount = std::max(m_nodeCount, m_scheduler.node(i) + 1);
+		}
+	}
 
 	Renderer::~Renderer()
 	{
-		for (const auto &thread : m_threads)
+		m_scheduler.removeJob(m_job);
+	}
+
+	void Renderer::priority(i32 priority)
+	{
+		m_scheduler.priority(m_job, priority);
+	}
+
+	void Renderer::draw(const Scene &scene, const Camera &camera, Framebuffer &framebuffer)
+	{
+		m_samples = Samples;
+		control();
+		beginDraw(scene, camera, framebuffer);
+
+		const auto startStats = m_scheduler.stats(m_job);
+		const auto startRays = raysTraced();
+		const Timer jobTimer{};
+
+		const auto totalTiles = dispatch(TaskType::Render);
+
+		std::cout << "total tiles: " << totalTiles << std::endl;
+
+		Timer timer{};
+
+		const auto start = timer.time();
+
+		auto prevRemaining = totalTiles;
+		auto prevTotalTime = 0.0;
+
+		wait([&](u32 remainingTiles)
+		{
+			const auto time = timer.time();
+
+			const auto totalTime = time - start;
+			const auto timeSinceLast = totalTime - prevTotalTime;
+
+			if (false
+			//	|| (remainingTiles < prevRemaining && remainingTiles % 256 == 0)
+				|| timeSinceLast > 4.0
+			)
+			{
+				const auto tilesPerSec = static_cast<f64>(prevRemaining - remainingTiles) / timeSinceLast;
+
+				std::cout << "remaining tiles: " << remainingTiles
+					<< " (total time " << (totalTime * 1000.0) << " ms, "
+					<< tilesPerSec << " tiles/sec, estimated "
+					<< (static_cast<f64>(remainingTiles) / tilesPerSec) << " sec remaining)" << std::endl;
+
+				prevTotalTime = totalTime;
+				prevRemaining = remainingTiles;
+			}
+		});
+
+		const auto totalTime = timer.time() - start;
+		const auto tilesPerSec = static_cast<f64>(totalTiles) / totalTime;
+
+		const auto raysPerSec = static_cast<f64>(raysTraced() - startRays) / totalTime;
+
+		std::cout << "render time: " << (totalTime * 1000.0) << " ms, " << tilesPerSec << " tiles/sec, "
+			<< (raysPerSec / 1e6) << " Mrays/sec" << std::endl;
+
+		reportThroughput(startStats, jobTimer.time(), static_cast<u64>(m_width) * m_height * m_samples);
+	}
+
+	void Renderer::drawProgressive(const Scene &scene, const Camera &camera, Framebuffer &framebuffer,
+		const ProgressiveSettings &settings, const SnapshotCallback &snapshot,
+		const SnapshotCallback &checkpoint)
+	{
+		control();
+		beginDraw(scene, camera, framebuffer);
+
+		Timer timer{};
+
+		auto lastSnapshot = 0.0;
+		auto lastCheckpoint = 0.0;
+
+		u32 passesSinceSnapshot = 0;
+
+		auto samples = framebuffer.samples.empty() ? 0
+			: *std::min_element(framebuffer.samples.begin(), framebuffer.samples.end());
+
+		if (samples > 0)
+			std::cout << "resuming from " << samples << " spp" << std::endl;
+
+		const auto firstSamples = samples;
+		const auto startStats = m_scheduler.stats(m_job);
+
+		for (u32 pass = 0; samples < settings.totalSamples; ++pass)
 		{
-			m_queue.push({
-				.target = nullptr
+			m_samples = std::min(settings.passSamples, settings.totalSamples - samples);
+
+			dispatch(TaskType::Render);
+			wait();
+
+			samples += m_samples;
+			++passesSinceSnapshot;
+
+			const auto time = timer.time();
+
+			std::cout << "pass " << pass << ": " << samples << " spp (total time "
+				<< (time * 1000.0) << " ms)" << std::endl;
+
+			if (samples >= settings.totalSamples)
+				break;
+
+			if (checkpoint && settings.checkpointInterval > 0.0
+				&& time - lastCheckpoint >= settings.checkpointInterval)
+			{
+				checkpoint(framebuffer, samples);
+				lastCheckpoint = timer.time();
+			}
+
+			if ((settings.snapshotPasses > 0 && passesSinceSnapshot >= settings.snapshotPasses)
+				|| (settings.snapshotInterval > 0.0 && time - lastSnapshot >= settings.snapshotInterval))
+			{
+				snapshot(framebuffer, samples);
+
+				lastSnapshot = timer.time();
+				passesSinceSnapshot = 0;
+			}
+		}
+
+		const auto totalTime = timer.time();
+
+		std::cout << "render time: " << (totalTime * 1000.0) << " ms" << std::endl;
+
+		reportThroughput(startStats, totalTime, static_cast<u64>(m_width) * m_height * (samples - firstSamples));
+	}
+
+	void Renderer::drawSequence(const SequenceSettings &settings, const FrameSetup &setup, const FrameOutput &output)
+	{
+		if (settings.frames == 0)
+			return;
+
+		Timer timer{};
+
+		// double buffered, frame n uses slot n % 2
+		std::array<std::unique_ptr<Scene>, 2> scenes{};
+		std::array<Camera, 2> cameras{
+			Camera{settings.width, settings.height, 90.0F, 0.0F, 1.0F},
+			Camera{settings.width, settings.height, 90.0F, 0.0F, 1.0F}
+		};
+
+		std::array<HdrImage, 2> images{};
+		std::array<std::vector<u32>, 2> pixels{};
+		std::array<std::future<void>, 2> outputs{};
+
+		const auto prepare = [&](u32 frame)
+		{
+			auto &scene = scenes[frame % 2];
+			auto &camera = cameras[frame % 2];
+
+			scene = std::make_unique<Scene>();
+			setup(frame, *scene, camera);
+
+			scene->buildBvh();
+			camera.update();
+		};
+
+		Framebuffer framebuffer{settings.width, settings.height, settings.seed};
+
+		prepare(0);
+
+		for (u32 frame = 0; frame < settings.frames; ++frame)
+		{
+			const auto slot = frame % 2;
+
+			std::future<void> next{};
+
+			if (frame + 1 < settings.frames)
+				next = std::async(std::launch::async, prepare, frame + 1);
+
+			framebuffer.seed = settings.seed + frame;
+			framebuffer.clear();
+
+			draw(*scenes[slot], cameras[slot], framebuffer);
+
+			// this slot's last frame has to be written out before its buffers are reused
+			if (outputs[slot].valid())
+				outputs[slot].get();
+
+			develop(framebuffer, images[slot]);
+
+			pixels[slot].resize(images[slot].pixels.size());
+			resolve(images[slot], settings.post, pixels[slot].data());
+
+			outputs[slot] = std::async(std::launch::async, [&output, &images, &pixels, slot, frame]
+			{
+				output(frame, images[slot], pixels[slot].data());
 			});
+
+			if (next.valid())
+				next.get();
+
+			std::cout << "frame " << frame << " done (total time " << (timer.time() * 1000.0) << " ms)" << std::endl;
 		}
 
-		for (auto &thread : m_threads)
+		for (auto &pending : outputs)
 		{
-			thread.join();
+			if (pending.valid())
+				pending.get();
+		}
+
+		const auto totalTime = timer.time();
+
+		std::cout << "sequence time: " << (totalTime * 1000.0) << " ms, "
+			<< (static_cast<f64>(settings.frames) / totalTime) << " frames/sec" << std::endl;
+	}
+
+	void RenderJob::cancel() const
+	{
+		m_state->cancel.store(true, std::memory_order::relaxed);
+	}
+
+	f32 RenderJob::progress() const
+	{
+		if (m_state->samplesTotal == 0)
+			return 1.0F;
+
+		return std::min(static_cast<f32>(m_state->samplesTaken.load(std::memory_order::relaxed))
+			/ static_cast<f32>(m_state->samplesTotal), 1.0F);
+	}
+
+	bool RenderJob::finished() const
+	{
+		return waitFor(0.0);
+	}
+
+	bool RenderJob::waitFor(f64 seconds) const
+	{
+		return m_result.wait_for(std::chrono::duration<f64>{seconds}) == std::future_status::ready;
+	}
+
+	RenderResult RenderJob::wait() const
+	{
+		return m_result.get();
+	}
+
+	void Renderer::drawBands(const Scene &scene, const Camera &camera, const BandSettings &settings, const BandOutput &output)
+	{
+		Timer timer{};
+
+		const auto width = camera.width();
+		const auto height = camera.height();
+		const auto bandHeight = std::max(settings.bandTiles, 1U) * TileSize;
+
+		// pixels keep their image position, so bands come out exactly as they would in one piece
+		Framebuffer framebuffer{};
+		framebuffer.seed = settings.seed;
+		framebuffer.width = width;
+
+		// double buffered, band n uses slot n % 2
+		std::array<HdrImage, 2> images{};
+		std::array<std::vector<u32>, 2> pixels{};
+
+		// bands are written in order, so each output waits for the previous one
+		std::future<void> pending{};
+
+		for (u32 y = 0, band = 0; y < height; y += bandHeight, ++band)
+		{
+			const auto slot = band % 2;
+			const auto rows = std::min(bandHeight, height - y);
+
+			framebuffer.height = rows;
+			framebuffer.originY = y;
+			framebuffer.clear();
+
+			draw(scene, camera, framebuffer);
+
+			develop(framebuffer, images[slot]);
+
+			pixels[slot].resize(images[slot].pixels.size());
+			resolve(images[slot], settings.post, pixels[slot].data());
+
+			if (pending.valid())
+				pending.get();
+
+			pending = std::async(std::launch::async, [&output, &pixels, slot, y, rows]
+			{
+				output(y, rows, pixels[slot].data());
+			});
+
+			std::cout << "rows " << y << "-" << (y + rows) << " of " << height
+				<< " done (total time " << (timer.time() * 1000.0) << " ms)" << std::endl;
 		}
+
+		if (pending.valid())
+			pending.get();
+
+		std::cout << "banded render time: " << (timer.time() * 1000.0) << " ms" << std::endl;
 	}
 
-	void Renderer::draw(const Camera &camera, u32 *data, u32 width, u32 height)
+	RenderJob Renderer::drawAsync(const Scene &scene, const Camera &camera, Framebuffer &framebuffer,
+		const AsyncSettings &settings)
 	{
-		if (m_threads.empty())
+		RenderJob job{};
+
+		job.m_state = std::make_shared<RenderJob::State>();
+		job.m_state->samplesTotal = static_cast<u64>(framebuffer.width) * framebuffer.height * settings.totalSamples;
+
+		job.m_result = std::async(std::launch::async, [this, &scene, &camera, &framebuffer, settings, state = job.m_state]
 		{
-			const u32 threadCount = Threads == 0 ? std::thread::hardware_concurrency() : Threads;
+			return runJob(scene, camera, framebuffer, settings, *state);
+		}).share();
 
-			std::cout << "launching " << threadCount << " threads" << std::endl;
+		return job;
+	}
+
+	RenderResult Renderer::runJob(const Scene &scene, const Camera &camera, Framebuffer &framebuffer,
+		const AsyncSettings &settings, RenderJob::State &state)
+	{
+		Timer timer{};
 
-			m_threads.reserve(threadCount);
+		control(&state.cancel, settings.deadline, &state.samplesTaken);
+		beginDraw(scene, camera, framebuffer);
 
-			for (i32 i = 0; i < threadCount; ++i)
+		auto samples = framebuffer.samples.empty() ? 0
+			: *std::min_element(framebuffer.samples.begin(), framebuffer.samples.end());
+
+		u32 passSamples = 1;
+
+		while (samples < settings.totalSamples && !stopped())
+		{
+			m_samples = std::min(passSamples, settings.totalSamples - samples);
+
+			dispatch(TaskType::Render);
+			wait();
+
+			samples += m_samples;
+			passSamples = std::min(passSamples * 2, std::max(settings.maxPassSamples, 1U));
+		}
+
+		const auto cancelled = state.cancel.load(std::memory_order::relaxed);
+
+		control();
+
+		// a pass that got stopped partway leaves its pixels split between two counts
+		const auto [minSamples, maxSamples] = sampleRange(framebuffer);
+
+		const auto status = minSamples >= settings.totalSamples ? RenderStatus::Complete
+			: cancelled ? RenderStatus::Cancelled
+			: RenderStatus::DeadlineExceeded;
+
+		const auto time = timer.time();
+
+		std::cout << "async render " << (status == RenderStatus::Complete ? "complete"
+				: status == RenderStatus::Cancelled ? "cancelled" : "past its deadline")
+			<< ": " << minSamples << "-" << maxSamples << " spp (total time " << (time * 1000.0) << " ms)" << std::endl;
+
+		return {
+			.status = status,
+			.minSamples = minSamples,
+			.maxSamples = maxSamples,
+			.time = time
+		};
+	}
+
+	RenderResult Renderer::drawBudgeted(const Scene &scene, const Camera &camera, Framebuffer &framebuffer, f64 budget)
+	{
+		Timer timer{};
+
+		beginDraw(scene, camera, framebuffer);
+
+		// the pilot pass
+		u32 passSamples = 1;
+
+		while (true)
+		{
+			m_samples = passSamples;
+
+			const auto start = timer.time();
+
+			// whole passes always finish, so every pixel has the same count going into the last
+			dispatch(TaskType::Render);
+			wait();
+
+			// measured on every pass, the pilot's also pays for the tile cost estimation
+			const auto secondsPerSample = (timer.time() - start) / static_cast<f64>(passSamples);
+			const auto affordable = (budget - timer.time()) / secondsPerSample;
+
+			// not enough time left for another whole pass. the last one runs until the budget
+			// is up, which leaves the tiles it reached (most expensive first, with cost
+			// ordering) with one sample more
+			if (affordable < 1.0)
 			{
-				m_threads.emplace_back([this, &camera]
+				const auto remaining = budget - timer.time();
+
+				if (remaining > 0.0)
 				{
-					Rng rng{};
+					control(nullptr, remaining);
 
-					while (true)
-					{
-						auto tile = m_queue.wait();
+					m_samples = 1;
 
-						if (!tile.target)
-							break;
+					dispatch(TaskType::Render);
+					wait();
 
-						for (u32 y = tile.startY; y < tile.endY; ++y)
-						{
-							for (u32 x = tile.startX; x < tile.endX; ++x)
-							{
-								glm::vec3 result{};
+					control();
+				}
 
-								for (u32 i = 0; i < Samples; ++i)
-								{
-									const auto ray = camera.ray(rng, x, y);
-									result += trace(m_scene, ray, rng);
-								}
+				break;
+			}
 
-								result /= static_cast<f32>(Samples);
+			// half of what looks affordable, so the estimate gets refined before the end
+			passSamples = std::max(static_cast<u32>(affordable / 2.0), 1U);
+		}
 
-								result = glm::max(result, glm::vec3{});
+		const auto [minSamples, maxSamples] = sampleRange(framebuffer);
+		const auto time = timer.time();
 
-								if constexpr(Tonemap)
-									result = result / (1.0F + result); // reinhard
+		std::cout << "budgeted render: " << minSamples << "-" << maxSamples << " spp in "
+			<< (time * 1000.0) << " ms of " << (budget * 1000.0) << " ms" << std::endl;
 
-								if constexpr(GammaCorrect)
-									result = glm::pow(result, InvGamma);
+		return {
+			.status = RenderStatus::Complete,
+			.minSamples = minSamples,
+			.maxSamples = maxSamples,
+			.time = time
+		};
+	}
 
-								tile.target[y * camera.width() + x] = toColor(result);
-							}
-						}
+	bool Renderer::drawPreview(const Scene &scene, const Camera &camera, const PreviewSettings &settings,
+		const PreviewOutput &output, const std::atomic<bool> *cancel)
+	{
+		Timer timer{};
 
-						{
-							std::scoped_lock lock{m_mutex};
-							--m_tileCounter;
-							m_signal.notify_all();
-						}
-					}
-				});
+		const auto cancelled = [this, cancel]
+		{
+			if (!cancel || !cancel->load(std::memory_order::relaxed))
+				return false;
+
+			control();
+			return true;
+		};
+
+		m_scene = &scene;
+		control(cancel);
+
+		replicateScene();
+
+		const auto width = camera.width();
+		const auto height = camera.height();
+
+		HdrImage coarseImage{};
+		HdrImage image{};
+		std::vector<u32> pixels(static_cast<std::size_t>(width) * height);
+
+		bool first = true;
+
+		const auto present = [&](u32 stride, u32 samples)
+		{
+			resolve(image, settings.post, pixels.data());
+
+			const auto time = timer.time();
+
+			if (first)
+			{
+				std::cout << "time to first image: " << (time * 1000.0) << " ms" << std::endl;
+				first = false;
+			}
+
+			output({
+				.image = image,
+				.pixels = pixels.data(),
+				.stride = stride,
+				.samples = samples,
+				.time = time
+			});
+		};
+
+		m_samples = 1;
+		m_bounces = std::min(settings.coarseBounces, Bounces);
+
+		for (auto stride = settings.firstStride; stride > 1; stride /= 2)
+		{
+			// same view, fewer pixels (at least two, for the camera's pixel spacing)
+			auto coarseCamera = camera;
+			coarseCamera.width(std::max((width + stride - 1) / stride, 2U));
+			coarseCamera.height(std::max((height + stride - 1) / stride, 2U));
+			coarseCamera.update();
+
+			Framebuffer coarse{coarseCamera.width(), coarseCamera.height(), settings.seed};
+
+			m_camera = &coarseCamera;
+			m_framebuffer = &coarse;
+			m_width = coarse.width;
+			m_height = coarse.height;
+			m_costsValid = false;
+
+			dispatch(TaskType::Render);
+			wait();
+
+			if (cancelled())
+				return false;
+
+			develop(coarse, coarseImage);
+
+			// nearest neighbour, each coarse pixel fills its block
+			image.resize(width, height);
+
+			for (u32 y = 0; y < height; ++y)
+			{
+				for (u32 x = 0; x < width; ++x)
+				{
+					image.pixels[y * width + x] = coarseImage.pixels[(y / stride) * coarseImage.width + x / stride];
+				}
 			}
+
+			present(stride, 1);
 		}
 
-		const auto totalTiles = ((width + TileSize - 1) / TileSize) * ((height + TileSize - 1) / TileSize);
+		m_bounces = Bounces;
 
-		std::cout << "total tiles: " << totalTiles << std::endl;
+		Framebuffer framebuffer{width, height, settings.seed};
+
+		m_camera = &camera;
+		m_framebuffer = &framebuffer;
+		m_width = width;
+		m_height = height;
+		m_costsValid = false;
+
+		u32 passSamples = 1;
+
+		for (u32 samples = 0; samples < settings.totalSamples;)
+		{
+			m_samples = std::min(passSamples, settings.totalSamples - samples);
+
+			m_framebuffer = &framebuffer;
+			m_width = width;
+			m_height = height;
+
+			dispatch(TaskType::Render);
+			wait();
+
+			// a cancelled pass leaves some tiles a pass behind, so it isn't shown
+			if (cancelled())
+				return false;
+
+			samples += m_samples;
+			passSamples = std::min(passSamples * 2, std::max(settings.maxPassSamples, 1U));
+
+			develop(framebuffer, image);
+			present(1, samples);
+		}
+
+		control();
+
+		std::cout << "preview time: " << (timer.time() * 1000.0) << " ms" << std::endl;
+
+		return true;
+	}
+
+	bool Renderer::stopped() const
+	{
+		return (m_cancel && m_cancel->load(std::memory_order::relaxed))
+			|| (m_deadline > 0.0 && m_deadlineTimer.time() >= m_deadline);
+	}
+
+	void Renderer::develop(const Framebuffer &framebuffer, HdrImage &image)
+	{
+		Timer timer{};
+
+		m_source = &framebuffer;
+		m_image = &image;
+
+		m_width = framebuffer.width;
+		m_height = framebuffer.height;
 
-		m_tileCounter.store(totalTiles);
+		image.resize(m_width, m_height);
 
-		for (u32 y = 0; y < height; y += TileSize)
+		if constexpr(Denoise)
 		{
-			for (u32 x = 0; x < width; x += TileSize)
+			m_features.resize(image.pixels.size());
+			m_denoiseTarget.resize(image.pixels.size());
+		}
+
+		dispatch(TaskType::Average);
+		wait();
+
+		if constexpr(Denoise)
+		{
+			for (m_denoisePass = 0; m_denoisePass < DenoisePasses; ++m_denoisePass)
+			{
+				dispatch(TaskType::Denoise);
+				wait();
+
+				std::swap(image.pixels, m_denoiseTarget);
+			}
+		}
+
+		std::cout << "develop time: " << (timer.time() * 1000.0) << " ms" << std::endl;
+	}
+
+	void Renderer::resolve(const HdrImage &image, const PostSettings &settings, u32 *data)
+	{
+		Timer timer{};
+
+		m_resolveSource = &image;
+		m_settings = settings;
+		m_exposureScale = std::exp2(settings.exposure);
+		m_target = data;
+
+		m_width = image.width;
+		m_height = image.height;
+
+		dispatch(TaskType::Resolve);
+		wait();
+
+		std::cout << "resolve time: " << (timer.time() * 1000.0) << " ms" << std::endl;
+	}
+
+	void Renderer::beginDraw(const Scene &scene, const Camera &camera, Framebuffer &framebuffer)
+	{
+		m_bounces = Bounces;
+		m_costsValid = false;
+		m_scene = &scene;
+		m_camera = &camera;
+		m_framebuffer = &framebuffer;
+		m_width = framebuffer.width;
+		m_height = framebuffer.height;
+
+		replicateScene();
+	}
+
+	void Renderer::replicateScene()
+	{
+		m_replicas.clear();
+
+		if (!ReplicateScene || m_nodeCount < 2)
+			return;
+
+		Timer timer{};
+
+		m_replicas.resize(m_nodeCount);
+
+		std::vector<std::thread> threads{};
+
+		// each copy is made by a thread on its node, so the kernel places its pages there
+		for (u32 node = 0; node < m_nodeCount; ++node)
+		{
+			u32 worker = 0;
+
+			while (m_scheduler.node(worker) != node || !m_scheduler.cpu(worker))
 			{
-				m_queue.push({
-					.target = data,
+				++worker;
+			}
+
+			const auto cpu = *m_scheduler.cpu(worker);
+
+			threads.emplace_back([this, node, cpu]
+			{
+				pinCurrentThread(cpu);
+				m_replicas[node] = std::make_unique<Scene>(*m_scene);
+			});
+		}
+
+		for (auto &thread : threads)
+		{
+			thread.join();
+		}
+
+		std::cout << "replicated scene to " << m_nodeCount << " nodes ("
+			<< (timer.time() * 1000.0) << " ms)" << std::endl;
+	}
+
+	const Scene &Renderer::localScene() const
+	{
+		if (!m_replicas.empty())
+		{
+			const auto worker = m_scheduler.currentWorker();
+
+			if (worker != Scheduler::NoWorker)
+				return *m_replicas[m_scheduler.node(worker)];
+		}
+
+		return *m_scene;
+	}
+
+	u32 Renderer::dispatch(TaskType type)
+	{
+		const auto order = type == TaskType::Render ? m_tileOrder : TileOrder::RowMajor;
+		const bool costOrdered = order == TileOrder::Cost;
+
+		if (costOrdered && !m_costsValid)
+		{
+			Timer timer{};
+
+			dispatch(TaskType::Estimate);
+			wait();
+
+			m_costsValid = true;
+
+			std::cout << "tile cost estimation: " << (timer.time() * 1000.0) << " ms" << std::endl;
+		}
+
+		m_tasks.clear();
+
+		for (u32 y = 0; y < m_height; y += TileSize)
+		{
+			for (u32 x = 0; x < m_width; x += TileSize)
+			{
+				m_tasks.push_back({
+					.type = type,
+					.tile = static_cast<u32>(m_tasks.size()),
 					.startX = x,
-					.endX = std::min(width, x + TileSize),
+					.endX = std::min(m_width, x + TileSize),
 					.startY = y,
-					.endY = std::min(height, y + TileSize)
+					.endY = std::min(m_height, y + TileSize)
 				});
 			}
 		}
 
-		std::unique_lock lock{m_mutex};
+		const auto totalTiles = static_cast<u32>(m_tasks.size());
 
-		Timer timer{};
+		if (type == TaskType::Estimate)
+			m_tileCosts.resize(totalTiles);
 
-		const auto start = timer.time();
+		// most expensive first, dealt out round-robin so every thread
+		// starts on a similar mix (longest processing time first)
+		if (costOrdered)
+			std::stable_sort(m_tasks.begin(), m_tasks.end(), [this](const Task &a, const Task &b)
+			{
+				return m_tileCosts[a.tile] > m_tileCosts[b.tile];
+			});
+		// neighbouring tiles end up in the same thread's contiguous share,
+		// and close together in time, so they share more of the bvh in cache
+		else if (order == TileOrder::Morton || order == TileOrder::Hilbert)
+		{
+			const auto tilesX = (m_width + TileSize - 1) / TileSize;
+			const auto tilesY = (m_height + TileSize - 1) / TileSize;
+
+			const auto side = std::bit_ceil(std::max(tilesX, tilesY));
+
+			std::vector<u32> keys(totalTiles);
+
+			for (u32 tile = 0; tile < totalTiles; ++tile)
+			{
+				const auto x = tile % tilesX;
+				const auto y = tile / tilesX;
+
+				keys[tile] = order == TileOrder::Morton
+					? curves::morton(x, y)
+					: curves::hilbert(side, x, y);
+			}
+
+			std::sort(m_tasks.begin(), m_tasks.end(), [&keys](const Task &a, const Task &b)
+			{
+				return keys[a.tile] < keys[b.tile];
+			});
+		}
 
-		m_signal.wait(lock, [this, totalTiles, &timer, start]
+		// spare slots for tiles split off at the end of each slice
+		if constexpr(SplitTiles)
+			m_tasks.resize(totalTiles + m_scheduler.threadCount() * SpareTasksPerThread);
+
+		m_taskCount = totalTiles;
+		m_sliceBegin = m_sliceEnd = 0;
+
+		m_distribution = costOrdered ? Scheduler::Distribution::Interleaved : Scheduler::Distribution::Contiguous;
+
+		startSlice();
+
+		return totalTiles;
+	}
+
+	void Renderer::startSlice()
+	{
+		// cost ordered slices take the most expensive tiles that are left, still dealt out round-robin
+		m_sliceBegin = m_sliceEnd;
+		m_sliceEnd = std::min(m_taskCount, m_sliceBegin + m_scheduler.threadCount() * SliceTilesPerThread);
+
+		// the previous slice is done with the spare slots
+		if constexpr(SplitTiles)
+			m_nextTask.store(m_taskCount, std::memory_order::relaxed);
+
+		m_scheduler.start(m_sliceEnd - m_sliceBegin, [this](u32 idx)
 		{
-			static auto prevRemaining = totalTiles;
-			static auto prevTotalTime = 0.0;
+			const auto &task = m_tasks[m_sliceBegin + idx];
 
-			const auto remainingTiles = m_tileCounter.load();
+			switch (task.type)
+			{
+			case TaskType::Estimate: estimateTile(task); break;
+			case TaskType::Render: renderOrSplit(task); break;
+			case TaskType::Average: averageTile(task); break;
+			case TaskType::Denoise: denoiseTile(task); break;
+			case TaskType::Resolve: resolveTile(task); break;
+			}
+		}, m_distribution, m_job);
+	}
 
-			if (remainingTiles > 0)
+	void Renderer::wait(const std::function<void (u32)> &progress)
+	{
+		while (true)
+		{
+			if (progress)
 			{
-				const auto time = timer.time();
+				const auto queued = m_taskCount - m_sliceEnd;
 
-				const auto totalTime = time - start;
-				const auto timeSinceLast = totalTime - prevTotalTime;
+				auto remaining = m_sliceEnd - m_sliceBegin;
 
-				if (false
-				//	|| (remainingTiles < prevRemaining && remainingTiles % 256 == 0)
-					|| timeSinceLast > 4.0
-				)
+				while ((remaining = m_scheduler.waitProgress(remaining)) > 0)
 				{
-					const auto tilesPerSec = static_cast<f64>(prevRemaining - remainingTiles) / timeSinceLast;
+					progress(queued + remaining);
+				}
+			}
 
-					std::cout << "remaining tiles: " << remainingTiles
-						<< " (total time " << (totalTime * 1000.0) << " ms, "
-						<< tilesPerSec << " tiles/sec, estimated "
-						<< (static_cast<f64>(remainingTiles) / tilesPerSec) << " sec remaining)" << std::endl;
+			m_scheduler.wait(m_job, m_sliceEnd < m_taskCount);
 
-					prevTotalTime = totalTime;
-					prevRemaining = remainingTiles;
-				}
+			if (m_sliceEnd == m_taskCount)
+				break;
 
-				return false;
+			startSlice();
+		}
+	}
+
+	void Renderer::reportThroughput(const Scheduler::JobStats &start, f64 time, u64 samples) const
+	{
+		const auto stats = m_scheduler.stats(m_job);
+
+		std::cout << m_name << ": " << (static_cast<f64>(samples) / time / 1e6) << " Msamples/sec, "
+			<< (stats.batches - start.batches) << " batches holding the pool "
+			<< ((stats.busyTime - start.busyTime) / time * 100.0) << "% of the time" << std::endl;
+	}
+
+	void Renderer::estimateTile(const Task &task)
+	{
+		const auto &scene = localScene();
+		const auto &camera = *m_camera;
+
+		const auto width = task.endX - task.startX;
+		const auto height = task.endY - task.startY;
+
+		Timer timer{};
+
+		FirstHit features{};
+		glm::vec3 sink{};
+
+		for (u32 i = 0; i < CostProbes; ++i)
+		{
+			// separate from the framebuffer's streams, these samples are thrown away
+			SampleRng rng{~m_framebuffer->seed, task.tile, i};
+
+			const auto x = task.startX + rng.nextU32(width);
+			const auto y = task.startY + rng.nextU32(height);
+
+			const auto ray = camera.ray(rng, m_framebuffer->originX + x, m_framebuffer->originY + y);
+			u64 rays = 0;
+			sink += trace(scene, ray, m_bounces, rng, features, rays);
+		}
+
+		// keeps the probes from being optimised out
+		m_tileCosts[task.tile] = static_cast<f32>(timer.time()) + (sink.x == -1.0F ? 1.0F : 0.0F);
+	}
+
+	void Renderer::renderOrSplit(Task task)
+	{
+		if constexpr(SplitTiles)
+		{
+			// once fewer tiles are waiting than there are threads, halve this one and
+			// offer the other half up for stealing, so nobody sits idle at the end of a pass
+			while (m_scheduler.unclaimed() < m_scheduler.threadCount())
+			{
+				const auto width = task.endX - task.startX;
+				const auto height = task.endY - task.startY;
+
+				if (width <= MinSplitSize && height <= MinSplitSize)
+					break;
+
+				const auto idx = m_nextTask.fetch_add(1, std::memory_order::relaxed);
+
+				if (idx >= m_tasks.size())
+					break;
+
+				auto &other = m_tasks[idx];
+				other = task;
+
+				if (width >= height)
+					task.endX = other.startX = task.startX + width / 2;
+				else task.endY = other.startY = task.startY + height / 2;
+
+				m_scheduler.spawn(idx - m_sliceBegin);
 			}
+		}
 
-			return true;
+		renderTile(task);
+	}
+
+	void Renderer::renderTile(const Task &task)
+	{
+		if (stopped())
+			return;
+
+		const auto &scene = localScene();
+		const auto &camera = *m_camera;
+		auto &framebuffer = *m_framebuffer;
+
+		u64 rays = 0;
+
+		forEachPixel(m_pixelOrder, task.startX, task.endX, task.startY, task.endY, [&](u32 x, u32 y)
+		{
+			const auto idx = y * m_width + x;
+
+			// streams are keyed on the position in the whole image, so
+			// rendering it in parts gives the same result
+			const auto imageX = framebuffer.originX + x;
+			const auto imageY = framebuffer.originY + y;
+
+			const auto pixel = imageY * camera.width() + imageX;
+			const auto firstSample = framebuffer.firstSample + framebuffer.samples[idx];
+
+			// added one sample at a time, in sample order, so that the sums come out
+			// the same however the samples are split into passes
+			auto color = framebuffer.color[idx];
+
+			FirstHit features{};
+
+			glm::vec3 albedo{};
+			glm::vec3 normal{};
+			f32 depth{};
+
+			if constexpr(Denoise)
+			{
+				albedo = framebuffer.features.albedo[idx];
+				normal = framebuffer.features.normal[idx];
+				depth = framebuffer.features.depth[idx];
+			}
+
+			for (u32 i = 0; i < m_samples; ++i)
+			{
+				SampleRng rng{framebuffer.seed, pixel, firstSample + i};
+
+				const auto ray = camera.ray(rng, imageX, imageY);
+				color += trace(scene, ray, m_bounces, rng, features, rays);
+
+				if constexpr(Denoise)
+				{
+					albedo += features.albedo;
+					normal += features.normal;
+					depth += features.depth;
+				}
+			}
+
+			framebuffer.color[idx] = color;
+			framebuffer.samples[idx] += m_samples;
+
+			if constexpr(Denoise)
+			{
+				framebuffer.features.albedo[idx] = albedo;
+				framebuffer.features.normal[idx] = normal;
+				framebuffer.features.depth[idx] = depth;
+			}
 		});
 
-		const auto totalTime = timer.time() - start;
-		const auto tilesPerSec = static_cast<f64>(totalTiles) / totalTime;
+		m_rays.fetch_add(rays, std::memory_order::relaxed);
+
+		if (m_progress)
+		{
+			const auto pixels = static_cast<u64>(task.endX - task.startX) * (task.endY - task.startY);
+			m_progress->fetch_add(pixels * m_samples, std::memory_order::relaxed);
+		}
+
+		if (m_regionDone)
+			m_regionDone(framebuffer, task.startX, task.endX, task.startY, task.endY);
+	}
+
+	void Renderer::averageTile(const Task &task)
+	{
+		const auto &framebuffer = *m_source;
+		auto &image = *m_image;
+
+		for (u32 y = task.startY; y < task.endY; ++y)
+		{
+			for (u32 x = task.startX; x < task.endX; ++x)
+			{
+				const auto idx = y * m_width + x;
+
+				const auto samples = framebuffer.samples[idx];
+				const auto invSamples = samples == 0 ? 0.0F : 1.0F / static_cast<f32>(samples);
+
+				image.pixels[idx] = framebuffer.color[idx] * invSamples;
 
-		std::cout << "render time: " << (totalTime * 1000.0) << " ms, " << tilesPerSec << " tiles/sec" << std::endl;
+				if constexpr(Denoise)
+				{
+					m_features.albedo[idx] = framebuffer.features.albedo[idx] * invSamples;
+					m_features.normal[idx] = framebuffer.features.normal[idx] * invSamples;
+					m_features.depth[idx] = samples == 0 ? MissDepth : framebuffer.features.depth[idx] * invSamples;
+				}
+			}
+		}
+	}
+
+	void Renderer::denoiseTile(const Task &task)
+	{
+		denoiseRegion(m_image->pixels.data(), m_denoiseTarget.data(), m_features, {
+			.width = m_width,
+			.height = m_height,
+			.startX = task.startX,
+			.endX = task.endX,
+			.startY = task.startY,
+			.endY = task.endY
+		}, m_denoisePass, DenoisePasses);
+	}
+
+	void Renderer::resolveTile(const Task &task)
+	{
+		const auto &image = *m_resolveSource;
+
+		for (u32 y = task.startY; y < task.endY; ++y)
+		{
+			for (u32 x = task.startX; x < task.endX; ++x)
+			{
+				const auto idx = y * m_width + x;
+				m_target[idx] = developPixel(image.pixels[idx], m_settings, m_exposureScale);
+			}
+		}
 	}
 }
@@ -3,42 +3,374 @@
 #include "types.h"
 
 #include <vector>
-#include <thread>
-#include <mutex>
+#include <functional>
 #include <atomic>
+#include <memory>
+#include <future>
+#include <string>
 
 #include "scene.h"
 #include "camera.h"
 #include "rng.h"
-#include "queue.h"
+#include "scheduler.h"
+#include "topology.h"
+#include "denoise.h"
+#include "framebuffer.h"
+#include "postprocess.h"
+#include "timer.h"
+#include "config.h"
 
 namespace cpurt
 {
+	struct ProgressiveSettings
+	{
+		u32 totalSamples{Samples};
+		u32 passSamples{16};
+
+		// a snapshot is taken when either trigger fires, 0 disables a trigger
+		f64 snapshotInterval{10.0}; // seconds
+		u32 snapshotPasses{0};
+
+		f64 checkpointInterval{0.0}; // seconds, 0 disables
+	};
+
+	struct SequenceSettings
+	{
+		u32 frames{1};
+		u32 width{Width}, height{Height};
+
+		// frame n renders with seed + n
+		u32 seed{};
+
+		PostSettings post{};
+	};
+
+	struct BandSettings
+	{
+		u32 seed{};
+
+		// height of each band in whole tile rows
+		u32 bandTiles{4};
+
+		PostSettings post{};
+	};
+
+	struct PreviewSettings
+	{
+		u32 seed{};
+
+		// the first images trace one pixel per stride x stride block, with fewer bounces.
+		// the stride halves with every image down to full resolution
+		u32 firstStride{4};
+		u32 coarseBounces{4};
+
+		// full resolution passes start at 1 spp and double up to this
+		u32 maxPassSamples{16};
+		u32 totalSamples{Samples};
+
+		PostSettings post{};
+	};
+
+	struct PreviewImage
+	{
+		// always full size, coarse images are upscaled
+		const HdrImage &image;
+		const u32 *pixels;
+
+		// 1 once at full resolution
+		u32 stride;
+		u32 samples;
+
+		// seconds since the preview started
+		f64 time;
+	};
+
+	struct AsyncSettings
+	{
+		u32 totalSamples{Samples};
+
+		// passes start at 1 spp and double up to this, so there is a whole image early on
+		u32 maxPassSamples{16};
+
+		// seconds from the start, 0 for none. tiles not started by then are skipped
+		f64 deadline{0.0};
+	};
+
+	enum class RenderStatus : u32
+	{
+		Complete = 0,
+		Cancelled,
+		DeadlineExceeded,
+		_last
+	};
+
+	struct RenderResult
+	{
+		RenderStatus status;
+
+		// a stopped render leaves pixels with different sample counts
+		u32 minSamples, maxSamples;
+
+		f64 time; // seconds
+	};
+
+	// a render running in the background, see Renderer::drawAsync
+	class RenderJob
+	{
+	public:
+		RenderJob() = default;
+
+		// stops at the next tile, the tiles in flight still finish
+		void cancel() const;
+
+		// 0 to 1, by samples taken
+		[[nodiscard]] f32 progress() const;
+
+		[[nodiscard]] bool finished() const;
+
+		// false if the job is still running after that long
+		[[nodiscard]] bool waitFor(f64 seconds) const;
+
+		// blocks until the render completes, is cancelled or runs out of time.
+		// the framebuffer then holds the best image so far, with its per-pixel sample counts
+		RenderResult wait() const;
+
+	private:
+		friend class Renderer;
+
+		struct State
+		{
+			std::atomic<bool> cancel{false};
+			std::atomic<u64> samplesTaken{0};
+			u64 samplesTotal{};
+		};
+
+		std::shared_ptr<State> m_state{};
+		std::shared_future<RenderResult> m_result{};
+	};
+
+	enum class TileOrder : u32
+	{
+		RowMajor = 0,
+		Morton,
+		Hilbert,
+		// most expensive tiles first, from a probe pass per camera
+		Cost,
+		_last
+	};
+
+	enum class PixelOrder : u32
+	{
+		RowMajor = 0,
+		Morton,
+		_last
+	};
+
+	// called between passes with the samples per pixel so far,
+	// while no worker is touching the framebuffer
+	using SnapshotCallback = std::function<void (const Framebuffer &, u32)>;
+
+	// fills in an empty scene and the camera for a frame of a sequence, on another
+	// thread while the previous frame renders; the bvh is built afterwards
+	using FrameSetup = std::function<void (u32, Scene &, Camera &)>;
+
+	// receives each finished frame, on another thread while the next frame renders
+	// (and possibly while the frame after that is being set up)
+	using FrameOutput = std::function<void (u32, const HdrImage &, const u32 *)>;
+
+	// receives the first row and row count of each finished band, in order from the top,
+	// on another thread while the next band renders
+	using BandOutput = std::function<void (u32, u32, const u32 *)>;
+
+	// a finished region of the framebuffer (startX, endX, startY, endY), called on the
+	// worker that rendered it, so it has to be quick and safe to call concurrently
+	using RegionCallback = std::function<void (const Framebuffer &, u32, u32, u32, u32)>;
+
+	// receives every step of a preview, on the rendering thread while the pool is idle
+	using PreviewOutput = std::function<void (const PreviewImage &)>;
+
+	// draws on the process-wide worker pool as a job of its own. any number of renderers can
+	// draw at once, their tiles interleave on the pool by priority, with a fair share each
+	// among equal priorities. one renderer can draw any number of frames and scenes
 	class Renderer
 	{
 	public:
-		explicit Renderer(const Scene &scene);
+		explicit Renderer(std::string name = "renderer", i32 priority = 0);
 		~Renderer();
 
-		void draw(const Camera &camera, u32 *data, u32 width, u32 height);
+		Renderer(const Renderer &) = delete;
+		Renderer &operator=(const Renderer &) = delete;
+
+		// higher goes first, the pool only goes to lower priorities while no higher one wants it
+		void priority(i32 priority);
+
+		// accumulates Samples more samples per pixel into the framebuffer
+		void draw(const Scene &scene, const Camera &camera, Framebuffer &framebuffer);
+
+		// accumulates samples in passes over the whole image until every pixel has
+		// totalSamples, continuing from whatever the framebuffer already holds
+		void drawProgressive(const Scene &scene, const Camera &camera, Framebuffer &framebuffer,
+			const ProgressiveSettings &settings, const SnapshotCallback &snapshot,
+			const SnapshotCallback &checkpoint = {});
+
+		inline void tileOrder(TileOrder order) { m_tileOrder = order; }
+		[[nodiscard]] inline auto tileOrder() const { return m_tileOrder; }
+
+		inline void pixelOrder(PixelOrder order) { m_pixelOrder = order; }
+		[[nodiscard]] inline auto pixelOrder() const { return m_pixelOrder; }
+
+		// called for every region as soon as it is rendered, in every kind of draw
+		inline void regionDone(RegionCallback callback) { m_regionDone = std::move(callback); }
+
+		// renders frames back to back, setting up the next frame and
+		// writing out the previous one while the current one renders
+		void drawSequence(const SequenceSettings &settings, const FrameSetup &setup, const FrameOutput &output);
+
+		// renders the camera's image a band of tile rows at a time, so only two bands
+		// are ever held in memory. denoising only sees one band at a time
+		void drawBands(const Scene &scene, const Camera &camera, const BandSettings &settings, const BandOutput &output);
+
+		// returns right away, rendering on another thread in passes that double in samples.
+		// the renderer mustn't be used for anything else, and everything passed in has to
+		// stay alive, until the job has finished
+		[[nodiscard]] RenderJob drawAsync(const Scene &scene, const Camera &camera, Framebuffer &framebuffer,
+			const AsyncSettings &settings);
+
+		// renders for budget seconds instead of a fixed number of samples. a 1 spp pilot pass
+		// measures throughput, the passes after it are sized to half the time that's left, and
+		// only the last 1 spp one is cut off when the budget runs out, so pixels differ by at most
+		// one sample. if throughput drops mid-pass (another job on the pool), the budget overruns
+		RenderResult drawBudgeted(const Scene &scene, const Camera &camera, Framebuffer &framebuffer, f64 budget);
+
+		// coarse to fine: subsampled, low-bounce 1 spp images first, then full resolution passes
+		// up to totalSamples, handing each one to output. returns false if cancel got set,
+		// which stops it as soon as the tiles in flight are done
+		bool drawPreview(const Scene &scene, const Camera &camera, const PreviewSettings &settings,
+			const PreviewOutput &output, const std::atomic<bool> *cancel = nullptr);
+
+		// averages (and optionally denoises) accumulated samples into a linear image
+		void develop(const Framebuffer &framebuffer, HdrImage &image);
+
+		// exposure, tonemapping, gamma and quantisation to 8 bit rgba
+		void resolve(const HdrImage &image, const PostSettings &settings, u32 *data);
+
+		// rays (path segments, not just camera rays) traced by every render so far
+		[[nodiscard]] inline u64 raysTraced() const { return m_rays.load(std::memory_order::relaxed); }
+
+		// the worker pool, for other batches of work between renders (as the default job)
+		[[nodiscard]] inline Scheduler &scheduler() { return m_scheduler; }
 
 	private:
-		const Scene &m_scene;
+		enum class TaskType : u32
+		{
+			Estimate = 0,
+			Render,
+			Average,
+			Denoise,
+			Resolve
+		};
 
-		struct Tile
+		struct Task
 		{
-			u32 *target;
+			TaskType type;
+			u32 tile;
 			u32 startX, endX;
 			u32 startY, endY;
 		};
 
-		BlockingQueue<Tile> m_queue{};
-		std::vector<std::thread> m_threads{};
+		RenderResult runJob(const Scene &scene, const Camera &camera, Framebuffer &framebuffer,
+			const AsyncSettings &settings, RenderJob::State &state);
+
+		// sets how the next draw can be stopped early, and where it counts samples taken
+		inline void control(const std::atomic<bool> *cancel = nullptr, f64 deadline = 0.0,
+			std::atomic<u64> *progress = nullptr)
+		{
+			m_cancel = cancel;
+			m_deadline = deadline;
+			m_deadlineTimer = Timer{};
+			m_progress = progress;
+		}
+
+		[[nodiscard]] bool stopped() const;
+
+		// points the next draw at what it renders, and gets the scene onto every node
+		void beginDraw(const Scene &scene, const Camera &camera, Framebuffer &framebuffer);
+
+		void replicateScene();
+		[[nodiscard]] const Scene &localScene() const;
+
+		// queues the stage's tiles, and starts the first slice of them
+		u32 dispatch(TaskType type);
+		void startSlice();
+
+		// runs the remaining slices, with the tiles left whenever a few more finished
+		void wait(const std::function<void (u32)> &progress = {});
+
+		// samples per second and share of the pool over the time since start
+		void reportThroughput(const Scheduler::JobStats &start, f64 time, u64 samples) const;
+
+		void estimateTile(const Task &task);
+		void renderOrSplit(Task task);
+		void renderTile(const Task &task);
+		void averageTile(const Task &task);
+		void denoiseTile(const Task &task);
+		void resolveTile(const Task &task);
+
+		TileOrder m_tileOrder{TileOrder::Cost};
+		PixelOrder m_pixelOrder{PixelOrder::RowMajor};
+
+		RegionCallback m_regionDone{};
+
+		// current stage's inputs and outputs
+		u32 m_width{}, m_height{};
+
+		const Scene *m_scene{};
+		const Camera *m_camera{};
+		Framebuffer *m_framebuffer{};
+		u32 m_samples{Samples};
+		u32 m_bounces{Bounces};
+
+		// tiles are skipped once cancel is set, or deadline seconds have passed on the timer
+		const std::atomic<bool> *m_cancel{};
+		f64 m_deadline{};
+		Timer m_deadlineTimer{};
+
+		std::atomic<u64> *m_progress{};
+		std::atomic<u64> m_rays{0};
+		const Framebuffer *m_source{};
+
+		HdrImage *m_image{};
+		const HdrImage *m_resolveSource{};
+
+		PostSettings m_settings{};
+		f32 m_exposureScale{1.0F};
+		u32 *m_target{};
+
+		// averaged guide features and the denoiser's ping-pong buffer
+		FeatureBuffers m_features{};
+		std::vector<glm::vec3> m_denoiseTarget{};
+		u32 m_denoisePass{};
+
+		// per-tile cost estimates for the current camera
+		std::vector<f32> m_tileCosts{};
+		bool m_costsValid{false};
+
+		std::vector<Task> m_tasks{};
+		std::atomic<u32> m_nextTask{};
+
+		// tasks [sliceBegin, sliceEnd) of taskCount are running on the pool
+		u32 m_taskCount{};
+		u32 m_sliceBegin{}, m_sliceEnd{};
+		Scheduler::Distribution m_distribution{};
+
+		u32 m_nodeCount{1};
+
+		// per-node copies of the current scene, first touched by a thread on that node
+		std::vector<std::unique_ptr<Scene>> m_replicas{};
 
-		std::mutex m_mutex{};
-		std::condition_variable m_signal{};
-		std::atomic<u32> m_tileCounter{};
+		std::string m_name;
 
-		Rng m_rng{};
+		Scheduler &m_scheduler;
+		Scheduler::JobId m_job;
 	};
 }
@@ -8,38 +8,18 @@
 #include <glm/glm.hpp>
 #include <glm/gtx/norm.hpp>
 
+#include "sampling.h"
+
 namespace cpurt
 {
-	class Rng // jsf32
+	// everything derived from a source of uniform u32s
+	template <typename Derived>
+	class RandomSource
 	{
 	public:
-		explicit Rng(std::optional<u32> seed = {})
-			: m_a{0xF1EA5EED}
-		{
-			if (!seed)
-				seed = nextSeed();
-
-			m_b = m_c = m_d = *seed;
-
-			for (i32 i = 0; i < 20; ++i)
-			{
-				(void)nextU32();
-			}
-		}
-
-		[[nodiscard]] inline u32 nextU32()
-		{
-			const auto e = m_a - std::rotl(m_b, 27);
-			m_a = m_b ^ std::rotl(m_c, 17);
-			m_b = m_c + m_d;
-			m_c = m_d + e;
-			m_d = e + m_a;
-			return m_d;
-		}
-
 		[[nodiscard]] inline u32 nextU32(u32 range)
 		{
-			auto x = nextU32();
+			auto x = next();
 			auto m = static_cast<u64>(x) * static_cast<u64>(range);
 			auto l = static_cast<u32>(m);
 
@@ -56,7 +36,7 @@ namespace cpurt
 
 				while (l < t)
 				{
-					x = nextU32();
+					x = next();
 					m = static_cast<u64>(x) * static_cast<u64>(range);
 					l = static_cast<u32>(m);
 				}
@@ -67,7 +47,7 @@ namespace cpurt
 
 		[[nodiscard]] inline f32 nextF32()
 		{
-			return static_cast<f32>(nextU32() >> 8) * 0x1.0p-24F;
+			return static_cast<f32>(next() >> 8) * 0x1.0p-24F;
 		}
 
 		[[nodiscard]] inline glm::vec3 nextVector()
@@ -77,27 +57,45 @@ namespace cpurt
 
 		[[nodiscard]] inline glm::vec3 nextUnitOrLess()
 		{
-			while (true)
-			{
-				const auto candidate = nextVector();
-				if (glm::length2(candidate) <= 1.0F)
-					return candidate;
-			}
+			const auto u = nextF32();
+			const auto v = nextF32();
+			const auto r0 = nextF32();
+			const auto r1 = nextF32();
+			const auto r2 = nextF32();
+
+			glm::vec3 p;
+			sampling::uniformBall(u, v, r0, r1, r2, p.x, p.y, p.z);
+			return p;
 		}
 
 		[[nodiscard]] inline glm::vec3 nextUnit()
 		{
-			return glm::normalize(nextVector());
+			const auto u = nextF32();
+			const auto v = nextF32();
+
+			glm::vec3 p;
+			sampling::uniformSphere(u, v, p.x, p.y, p.z);
+			return p;
+		}
+
+		[[nodiscard]] inline glm::vec3 nextInHemisphere(const glm::vec3 &normal)
+		{
+			const auto u = nextF32();
+			const auto v = nextF32();
+
+			glm::vec3 p;
+			sampling::uniformHemisphere(u, v, normal.x, normal.y, normal.z, p.x, p.y, p.z);
+			return p;
 		}
 
 		[[nodiscard]] inline glm::vec2 nextInUnitDisk()
 		{
-			while (true)
-			{
-				const glm::vec2 candidate{nextF32() * 2.0F - 1.0F, nextF32() * 2.0F - 1.0F};
-				if (glm::length2(candidate) < 1.0F)
-					return candidate;
-			}
+			const auto u = nextF32();
+			const auto v = nextF32();
+
+			glm::vec2 p;
+			sampling::concentricDisk(u, v, p.x, p.y);
+			return p;
 		}
 
 		[[nodiscard]] inline glm::vec3 nextColor()
@@ -106,8 +104,103 @@ namespace cpurt
 		}
 
 	private:
+		[[nodiscard]] inline u32 next()
+		{
+			return static_cast<Derived *>(this)->nextU32();
+		}
+	};
+
+	class Rng : public RandomSource<Rng> // jsf32
+	{
+	public:
+		using RandomSource::nextU32;
+
+		explicit Rng(std::optional<u32> seed = {})
+			: m_a{0xF1EA5EED}
+		{
+			if (!seed)
+				seed = nextSeed();
+
+			m_b = m_c = m_d = *seed;
+
+			for (i32 i = 0; i < 20; ++i)
+			{
+				(void)nextU32();
+			}
+		}
+
+		[[nodiscard]] inline u32 nextU32()
+		{
+			const auto e = m_a - std::rotl(m_b, 27);
+			m_a = m_b ^ std::rotl(m_c, 17);
+			m_b = m_c + m_d;
+			m_c = m_d + e;
+			m_d = e + m_a;
+			return m_d;
+		}
+
+	private:
+		// unpredictable, for when no seed is given
 		static u32 nextSeed();
 
 		u32 m_a, m_b, m_c, m_d;
 	};
+
+	// counter-based: the n-th number drawn is a hash of (seed, pixel, sample, n), with no
+	// state carried between samples. a sample is the same whichever thread, pass or
+	// process renders it, and any range of a pixel's samples can be rendered on its own
+	class SampleRng : public RandomSource<SampleRng>
+	{
+	public:
+		using RandomSource::nextU32;
+
+		SampleRng(u32 seed, u32 pixel, u32 sample)
+			: m_seed{seed},
+			  m_pixel{pixel},
+			  m_sample{sample} {}
+
+		[[nodiscard]] inline u32 nextU32()
+		{
+			// each hash gives four dimensions
+			if ((m_dimension & 3) == 0)
+				hash(m_dimension >> 2);
+
+			return m_block[m_dimension++ & 3];
+		}
+
+	private:
+		// pcg4d, from jarzynski and olano, "hash functions for gpu rendering" (2020)
+		inline void hash(u32 block)
+		{
+			auto x = m_seed * 1664525 + 1013904223;
+			auto y = m_pixel * 1664525 + 1013904223;
+			auto z = m_sample * 1664525 + 1013904223;
+			auto w = block * 1664525 + 1013904223;
+
+			x += y * w;
+			y += z * x;
+			z += x * y;
+			w += y * z;
+
+			x ^= x >> 16;
+			y ^= y >> 16;
+			z ^= z >> 16;
+			w ^= w >> 16;
+
+			x += y * w;
+			y += z * x;
+			z += x * y;
+			w += y * z;
+
+			m_block[0] = x;
+			m_block[1] = y;
+			m_block[2] = z;
+			m_block[3] = w;
+		}
+
+		u32 m_seed, m_pixel, m_sample;
+
+		u32 m_dimension{0};
+		u32 m_block[4]{};
+	};
 }
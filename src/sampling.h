@@ -0,0 +1,76 @@
+#pragma once
+
+#include "types.h"
+
+#include "simd.h"
+
+// closed-form (rejection-free) warps from uniform [0, 1) variates,
+// instantiable for both scalar f32 and simd::f32x8
+namespace cpurt::sampling
+{
+	// shirley-chiu concentric mapping onto the unit disk
+	template <typename T>
+	inline void concentricDisk(T u, T v, T &x, T &y)
+	{
+		const auto a = u * 2.0F - 1.0F;
+		const auto b = v * 2.0F - 1.0F;
+
+		const auto horizontal = simd::abs(a) > simd::abs(b);
+
+		const auto r = horizontal ? a : b;
+		const auto ratio = (horizontal ? b : a) / (r == 0.0F ? simd::splat<T>(1.0F) : r);
+
+		const auto phi = horizontal
+			? simd::QuarterPi * ratio
+			: simd::HalfPi - simd::QuarterPi * ratio;
+
+		T s, c;
+		simd::sincos(phi, s, c);
+
+		x = r * c;
+		y = r * s;
+	}
+
+	// uniform on the surface of the unit sphere
+	template <typename T>
+	inline void uniformSphere(T u, T v, T &x, T &y, T &z)
+	{
+		z = 1.0F - 2.0F * u;
+
+		const auto r = simd::sqrt(simd::max(simd::splat<T>(0.0F), 1.0F - z * z));
+		const auto phi = 2.0F * simd::Pi * v - simd::Pi;
+
+		T s, c;
+		simd::sincos(phi, s, c);
+
+		x = r * c;
+		y = r * s;
+	}
+
+	// uniform within the unit ball - the max of three uniforms has cdf r^3,
+	// which is exactly the radial distribution needed, without a cbrt
+	template <typename T>
+	inline void uniformBall(T u, T v, T r0, T r1, T r2, T &x, T &y, T &z)
+	{
+		uniformSphere(u, v, x, y, z);
+
+		const auto r = simd::max(r0, simd::max(r1, r2));
+
+		x *= r;
+		y *= r;
+		z *= r;
+	}
+
+	// uniform on the hemisphere around (nx, ny, nz)
+	template <typename T>
+	inline void uniformHemisphere(T u, T v, T nx, T ny, T nz, T &x, T &y, T &z)
+	{
+		uniformSphere(u, v, x, y, z);
+
+		const auto flip = x * nx + y * ny + z * nz < 0.0F;
+
+		x = flip ? -x : x;
+		y = flip ? -y : y;
+		z = flip ? -z : z;
+	}
+}
@@ -2,9 +2,13 @@
 
 #include <array>
 #include <iostream>
+#include <numeric>
 
 #include <glm/gtx/norm.hpp>
 
+#include "arena.h"
+#include "simd.h"
+
 namespace cpurt
 {
 	namespace
@@ -14,7 +18,10 @@ namespace cpurt
 
 		constexpr auto HitEpsilon = 0.001F;
 
-		__attribute__((always_inline)) void closestHit(TraceResult &result,
+		// the tree is split at the median, so it's never deeper than log2 of the sphere count
+		constexpr u32 MaxBvhDepth = 64;
+
+		__attribute__((always_inline)) inline void closestHit(TraceResult &result,
 			const Scene &scene, const Ray &ray, const Sphere &hit, f32 distance)
 		{
 			const auto pos = ray.origin + ray.dir * distance;
@@ -26,7 +33,7 @@ namespace cpurt
 			result.hitNormal = normal;
 		}
 
-		__attribute__((always_inline)) void miss(TraceResult &result, const Scene &scene, const Ray &ray)
+		__attribute__((always_inline)) inline void miss(TraceResult &result, const Scene &scene, const Ray &ray)
 		{
 			result.hitMaterial = nullptr;
 
@@ -44,7 +51,7 @@ namespace cpurt
 
 		namespace intersection
 		{
-			__attribute__((always_inline))  bool aabb(const InvRay &ray, const Aabb &aabb, f32 t)
+			__attribute__((always_inline)) inline bool aabb(const InvRay &ray, const Aabb &aabb, f32 t)
 			{
 				const auto tx1 = (aabb.min.x - ray.origin.x) * ray.dir.x;
 				const auto tx2 = (aabb.max.x - ray.origin.x) * ray.dir.x;
@@ -67,7 +74,7 @@ namespace cpurt
 				return tMax >= std::max(HitEpsilon, tMin) && tMin < t;
 			}
 
-			__attribute__((always_inline)) f32 sphere(const Ray &ray, const Sphere &sphere)
+			__attribute__((always_inline)) inline f32 sphere(const Ray &ray, const Sphere &sphere)
 			{
 				const auto origin = ray.origin - sphere.pos;
 
@@ -102,9 +109,19 @@ namespace cpurt
 		}
 
 		template <i32 Axis>
-		inline bool compareSphereAabb(const Sphere *a, const Sphere *b)
+		inline bool compareSphereAabb(const Sphere &a, const Sphere &b)
+		{
+			return compareAabb<Axis>(a.aabb(), b.aabb());
+		}
+
+		inline Sphere makeSphere(const SphereData &data)
 		{
-			return compareAabb<Axis>(a->aabb(), b->aabb());
+			return Sphere {
+				.pos = data.pos,
+				.radius = data.radius,
+				.radius2 = data.radius * data.radius,
+				.materialId = data.materialId
+			};
 		}
 
 		inline Aabb boundingAabb(const Aabb &a, const Aabb &b)
@@ -122,16 +139,31 @@ namespace cpurt
 		(void)createMetal({1.0F, 0.0F, 1.0F}, 0.0F);
 	}
 
-	Sphere &Scene::createSphere(const SphereData &data)
+	void Scene::reserve(u32 spheres, u32 materials)
 	{
-		auto &sphere = m_spheres.emplace_back(Sphere {
-			.pos = data.pos,
-			.radius = data.radius,
-			.radius2 = data.radius * data.radius,
-			.materialId = data.materialId
-		});
-
-		return sphere;
+		m_spheres.reserve(m_spheres.size() + spheres);
+		m_materials.reserve(m_materials.size() + materials);
+	}
+
+	u32 Scene::createSphere(const SphereData &data)
+	{
+		const auto idx = static_cast<u32>(m_spheres.size());
+		m_spheres.push_back(makeSphere(data));
+		return idx;
+	}
+
+	u32 Scene::createSpheres(std::span<const SphereData> spheres)
+	{
+		const auto first = static_cast<u32>(m_spheres.size());
+
+		reserve(spheres.size());
+
+		for (const auto &data : spheres)
+		{
+			m_spheres.push_back(makeSphere(data));
+		}
+
+		return first;
 	}
 
 	void Scene::buildBvh()
@@ -146,35 +178,43 @@ namespace cpurt
 		}
 		else std::cout << m_spheres.size() << " spheres" << std::endl;
 
+		// a full binary tree, sized up front so it never regrows mid-build
+		m_nodes.reserve(m_spheres.size() * 2 - 1);
+
 		const auto root = allocNode(); // always 0
 
-		if (m_spheres.size() == 1)
-			m_nodes[root].sphere = &m_spheres[0];
-		else
-		{
-			std::vector<const Sphere *> spherePtrs{};
-			spherePtrs.reserve(m_spheres.size());
+		// sphere indices, sorted in place as the tree is split
+		Arena arena{m_spheres.size() * sizeof(u32)};
+		const auto indices = arena.alloc<u32>(m_spheres.size());
 
-			for (const auto &sphere : m_spheres)
-			{
-				spherePtrs.push_back(&sphere);
-			}
+		std::iota(indices.begin(), indices.end(), 0);
 
-			populateInternalNode(root, spherePtrs, 0, m_spheres.size());
-		}
+		populateInternalNode(root, indices, 0, m_spheres.size());
+
+		constexpr auto KiB = 1024.0;
+
+		std::cout << "bvh: " << m_nodes.size() << " nodes, "
+			<< (static_cast<f64>(m_nodes.size() * sizeof(Node)) / KiB) << " KiB (spheres "
+			<< (static_cast<f64>(m_spheres.size() * sizeof(Sphere)) / KiB) << " KiB, build temporaries "
+			<< (static_cast<f64>(arena.bytesReserved()) / KiB) << " KiB)" << std::endl;
 	}
 
 	void Scene::traceRay(TraceResult &result, const Ray &ray) const
+	{
+		traceKernel(result, ray);
+	}
+
+	CPURT_KERNEL void Scene::traceKernel(TraceResult &result, const Ray &ray) const
 	{
 		if constexpr(TraceBvh)
 		{
 			TraceContext ctx{};
 			InvRay invRay{ray};
 
-			traceBvh(ctx, ray, invRay, 0);
+			traceBvh(ctx, ray, invRay);
 
-			if (ctx.sphere)
-				closestHit(result, *this, ray, *ctx.sphere, ctx.t);
+			if (ctx.sphere != NoSphere)
+				closestHit(result, *this, ray, m_spheres[ctx.sphere], ctx.t);
 			else miss(result, *this, ray);
 		}
 		else
@@ -203,28 +243,38 @@ namespace cpurt
 		}
 	}
 
-	void Scene::traceBvh(TraceContext &ctx, const Ray &ray, const InvRay &invRay, u32 node) const
+	// with an explicit stack rather than recursion, so the whole traversal inlines into
+	// each variant of traceKernel. visits nodes in the same order as recursing would
+	__attribute__((always_inline)) inline void Scene::traceBvh(TraceContext &ctx, const Ray &ray, const InvRay &invRay) const
 	{
-		const auto &n = m_nodes[node];
+		std::array<u32, MaxBvhDepth + 1> stack;
+		u32 size = 0;
+
+		stack[size++] = 0;
 
-		if (n.sphere)
+		while (size > 0)
 		{
-			const auto t = intersection::sphere(ray, *n.sphere);
+			const auto &n = m_nodes[stack[--size]];
 
-			if (t > 0.0F && t < ctx.t)
+			if (n.sphere != NoSphere)
 			{
-				ctx.sphere = n.sphere;
-				ctx.t = t;
-			}
+				const auto t = intersection::sphere(ray, m_spheres[n.sphere]);
 
-			return;
-		}
+				if (t > 0.0F && t < ctx.t)
+				{
+					ctx.sphere = n.sphere;
+					ctx.t = t;
+				}
 
-		if (!intersection::aabb(invRay, n.aabb, ctx.t))
-			return;
+				continue;
+			}
 
-		traceBvh(ctx, ray, invRay, n.left);
-		traceBvh(ctx, ray, invRay, n.right);
+			if (!intersection::aabb(invRay, n.aabb, ctx.t))
+				continue;
+
+			stack[size++] = n.right;
+			stack[size++] = n.left;
+		}
 	}
 
 	u32 Scene::allocNode()
@@ -236,19 +286,19 @@ namespace cpurt
 
 	// basic kd tree split by the largest dimension
 	// (i.e. the "next week" bvh with modifications)
-	void Scene::populateInternalNode(u32 id, std::vector<const Sphere *> &spheres, u32 start, u32 end)
+	void Scene::populateInternalNode(u32 id, std::span<u32> spheres, u32 start, u32 end)
 	{
 		const auto count = end - start;
 
 		if (count == 1)
-			populateLeafNode(id, *spheres[start]);
+			populateLeafNode(id, spheres[start]);
 		else
 		{
-			m_nodes[id].aabb = spheres[start]->aabb();
+			m_nodes[id].aabb = m_spheres[spheres[start]].aabb();
 
 			for (u32 i = start + 1; i < end; ++i)
 			{
-				m_nodes[id].aabb = boundingAabb(m_nodes[id].aabb, spheres[i]->aabb());
+				m_nodes[id].aabb = boundingAabb(m_nodes[id].aabb, m_spheres[spheres[i]].aabb());
 			}
 
 			const auto size = m_nodes[id].aabb.max - m_nodes[id].aabb.min;
@@ -265,12 +315,17 @@ namespace cpurt
 				}
 			}
 
-			const auto comparator = axis == 0
+			const auto compareSpheres = axis == 0
 				? compareSphereAabb<0>
 				: axis == 1
 					? compareSphereAabb<1>
 					: compareSphereAabb<2>;
 
+			const auto comparator = [this, compareSpheres](u32 a, u32 b)
+			{
+				return compareSpheres(m_spheres[a], m_spheres[b]);
+			};
+
 			m_nodes[id].left = allocNode();
 			m_nodes[id].right = allocNode();
 
@@ -278,13 +333,13 @@ namespace cpurt
 			{
 				if (comparator(spheres[start], spheres[start + 1]))
 				{
-					populateLeafNode(m_nodes[id].left, *spheres[start]);
-					populateLeafNode(m_nodes[id].right, *spheres[start + 1]);
+					populateLeafNode(m_nodes[id].left, spheres[start]);
+					populateLeafNode(m_nodes[id].right, spheres[start + 1]);
 				}
 				else
 				{
-					populateLeafNode(m_nodes[id].left, *spheres[start + 1]);
-					populateLeafNode(m_nodes[id].right, *spheres[start]);
+					populateLeafNode(m_nodes[id].left, spheres[start + 1]);
+					populateLeafNode(m_nodes[id].right, spheres[start]);
 				}
 			}
 			else
@@ -299,11 +354,11 @@ namespace cpurt
 		}
 	}
 
-	void Scene::populateLeafNode(u32 id, const Sphere &sphere)
+	void Scene::populateLeafNode(u32 id, u32 sphere)
 	{
 		auto &node = m_nodes[id];
 
-		node.sphere = &sphere;
-		node.aabb = sphere.aabb();
+		node.sphere = sphere;
+		node.aabb = m_spheres[sphere].aabb();
 	}
 }
@@ -6,12 +6,15 @@
 #include <unordered_map>
 #include <algorithm>
 #include <cstddef>
+#include <span>
 
 #include <glm/glm.hpp>
 
 #include "material.h"
 #include "ray.h"
 #include "rng.h"
+#include "hugepage.h"
+#include "simd.h"
 
 namespace cpurt
 {
@@ -43,11 +46,14 @@ namespace cpurt
 		}
 	};
 
+	// index into the scene's spheres, rather than a pointer, so that scenes can be copied
+	constexpr u32 NoSphere = ~u32{0};
+
 	struct Node
 	{
 		Aabb aabb{};
 
-		const Sphere *sphere{};
+		u32 sphere{NoSphere};
 
 		u32 left{};
 		u32 right{};
@@ -55,7 +61,7 @@ namespace cpurt
 
 	struct TraceContext
 	{
-		const Sphere *sphere{};
+		u32 sphere{NoSphere};
 		f32 t{std::numeric_limits<f32>::infinity()};
 	};
 
@@ -75,7 +81,7 @@ namespace cpurt
 		Scene();
 		~Scene() = default;
 
-		[[nodiscard]] inline auto &createDiffuse(glm::vec3 albedo)
+		inline u32 createDiffuse(glm::vec3 albedo)
 		{
 			Material material {
 				.id = m_nextMaterialId++,
@@ -85,10 +91,10 @@ namespace cpurt
 				}
 			};
 
-			return m_materials.emplace_back(material);
+			return m_materials.emplace_back(material).id;
 		}
 
-		[[nodiscard]] inline auto &createMetal(glm::vec3 albedo, f32 roughness)
+		inline u32 createMetal(glm::vec3 albedo, f32 roughness)
 		{
 			Material material {
 				.id = m_nextMaterialId++,
@@ -99,10 +105,10 @@ namespace cpurt
 				}
 			};
 
-			return m_materials.emplace_back(material);
+			return m_materials.emplace_back(material).id;
 		}
 
-		[[nodiscard]] inline auto &createLight(glm::vec3 emitted)
+		inline u32 createLight(glm::vec3 emitted)
 		{
 			Material material {
 				.id = m_nextMaterialId++,
@@ -112,10 +118,10 @@ namespace cpurt
 				}
 			};
 
-			return m_materials.emplace_back(material);
+			return m_materials.emplace_back(material).id;
 		}
 
-		[[nodiscard]] inline auto &createDielectric(glm::vec3 color, f32 refractiveIndex)
+		inline u32 createDielectric(glm::vec3 color, f32 refractiveIndex)
 		{
 			Material material {
 				.id = m_nextMaterialId++,
@@ -126,10 +132,27 @@ namespace cpurt
 				}
 			};
 
-			return m_materials.emplace_back(material);
+			return m_materials.emplace_back(material).id;
+		}
+
+		// space for this many more spheres/materials, so bulk creation doesn't regrow
+		void reserve(u32 spheres, u32 materials = 0);
+
+		// returns the sphere's index, which stays valid (unlike references into the scene)
+		u32 createSphere(const SphereData &data);
+
+		// returns the index of the first new sphere, the rest follow consecutively
+		u32 createSpheres(std::span<const SphereData> spheres);
+
+		[[nodiscard]] inline const auto &sphere(u32 idx) const
+		{
+			return m_spheres[idx];
 		}
 
-		Sphere &createSphere(const SphereData &data);
+		[[nodiscard]] inline u32 sphereCount() const
+		{
+			return static_cast<u32>(m_spheres.size());
+		}
 
 		[[nodiscard]] inline const auto &material(u32 id) const
 		{
@@ -138,22 +161,36 @@ namespace cpurt
 
 		void buildBvh();
 
+		[[nodiscard]] inline std::size_t bvhBytes() const
+		{
+			return m_nodes.size() * sizeof(Node);
+		}
+
+		[[nodiscard]] inline std::size_t sphereBytes() const
+		{
+			return m_spheres.size() * sizeof(Sphere);
+		}
+
 		void traceRay(TraceResult &result, const Ray &ray) const;
 
 	private:
-		void traceBvh(TraceContext &ctx, const Ray &ray, const InvRay &invRay, u32 node) const;
+		// the per isa variants of traceRay, only called from scene.cpp (a variant
+		// called from another file would link against a clone gcc keeps local)
+		CPURT_KERNEL void traceKernel(TraceResult &result, const Ray &ray) const;
+
+		void traceBvh(TraceContext &ctx, const Ray &ray, const InvRay &invRay) const;
 
 		[[nodiscard]] u32 allocNode();
 
-		void populateInternalNode(u32 id, std::vector<const Sphere *> &spheres, u32 start, u32 end);
-		void populateLeafNode(u32 id, const Sphere &sphere);
+		void populateInternalNode(u32 id, std::span<u32> spheres, u32 start, u32 end);
+		void populateLeafNode(u32 id, u32 sphere);
 
 		std::vector<Material> m_materials{};
 		u32 m_nextMaterialId{};
 
-		std::vector<Sphere> m_spheres{};
+		HugePageVector<Sphere> m_spheres{};
 
-		std::vector<Node> m_nodes{};
+		HugePageVector<Node> m_nodes{};
 		u32 m_nextNodeId{};
 	};
 }
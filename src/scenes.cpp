@@ -0,0 +1,216 @@
+#include "scenes.h"
+
+#include <cmath>
+#include <vector>
+
+#include "rng.h"
+
+namespace cpurt
+{
+	namespace
+	{
+		// small sphere materials, picked from per sphere
+		constexpr u32 ScaledMaterials = 64;
+
+		// the ground and the three large spheres
+		constexpr u32 ScaledFixedSpheres = 4;
+	}
+
+	u32 initTestScene(Scene &scene)
+	{
+		const auto ground = scene.createDiffuse({0.8F, 0.8F, 0.0F});
+
+	//	const auto left = scene.createMetal({0.8F, 0.8F, 0.8F}, 0.3F);
+		const auto left = scene.createDielectric({1.0F, 1.0F, 1.0F}, 1.52F);
+
+	//	const auto center = scene.createDiffuse({0.7F, 0.3F, 0.3F});
+		const auto center = scene.createDiffuse({0.1F, 0.2F, 0.5F});
+
+	//	const auto right = scene.createMetal({0.8F, 0.6F, 0.2F}, 0.0F);
+	//	const auto right = scene.createDielectric({1.0F, 1.0F, 1.0F}, 1.5F);
+	//	const auto right = scene.createLight({4.8F, 3.6F, 1.2F});
+		const auto right = scene.createLight({-4.8F, -3.6F, -1.2F});
+
+		scene.createSphere({ // ground
+			.pos = {0.0F, -100.5F, 0.0F},
+			.radius = 100.0F,
+			.materialId = ground
+		});
+
+		scene.createSphere({ // left
+			.pos = {-1.0F, 0.0F, 0.0F},
+			.radius = 0.5F,
+			.materialId = left
+		});
+
+		const auto centerSphere = scene.createSphere({ // center
+			.pos = {0.0F, 0.0F, 0.0F},
+			.radius = 0.5F,
+			.materialId = center
+		});
+
+		scene.createSphere({ // right
+			.pos = {1.0F, 0.0F, 0.0F},
+			.radius = 0.5F,
+			.materialId = right
+		});
+
+		return centerSphere;
+	}
+
+	void initRandomScene(Scene &scene)
+	{
+		Rng rng{0x696969};
+
+		// at most 22 * 22 small spheres, plus the ground and three large ones
+		scene.reserve(22 * 22 + 4);
+
+		const auto groundMaterial = scene.createDiffuse({0.5F, 0.5F, 0.5F});
+		scene.createSphere({
+			.pos = {0.0F, -1000.0F, 0.0F},
+			.radius = 1000.0F,
+			.materialId = groundMaterial
+		});
+
+		const auto glass = scene.createDielectric({1.0F, 1.0F, 1.0F}, 1.52F);
+
+		for (i32 a = -11; a < 11; ++a)
+		{
+			for (i32 b = -11; b < 11; ++b)
+			{
+				const glm::vec3 center {
+					static_cast<f32>(a) + 0.9F * rng.nextF32(),
+					0.2F,
+					static_cast<f32>(b) + 0.9F * rng.nextF32()
+				};
+
+				if (glm::length(center - glm::vec3{4.0F, 0.2F, 0.0F}) > 0.9F)
+				{
+					const auto materialSelector = rng.nextF32();
+					u32 material;
+
+					if (materialSelector < 0.8F)
+						material = scene.createDiffuse(rng.nextColor() * rng.nextColor());
+					else if (materialSelector < 0.95F)
+					{
+						const auto albedo = rng.nextColor() * 0.5F + 0.5F;
+						const auto fuzz = rng.nextF32() * 0.5F;
+
+						material = scene.createMetal(albedo, fuzz);
+					}
+					else material = glass;
+
+					scene.createSphere({
+						.pos = center,
+						.radius = 0.2F,
+						.materialId = material
+					});
+				}
+			//	else std::cout << "skipping sphere" << std::endl;
+			}
+		}
+
+		scene.createSphere({
+			.pos = {0.0F, 1.0F, 0.0F},
+			.radius = 1.0F,
+			.materialId = glass
+		});
+
+		const auto material2 = scene.createDiffuse({0.4F, 0.2F, 0.1F});
+		scene.createSphere({
+			.pos = {-4.0F, 1.0F, 0.0F},
+			.radius = 1.0F,
+			.materialId = material2
+		});
+
+		const auto material3 = scene.createMetal({0.7F, 0.6F, 0.5F}, 0.0F);
+		scene.createSphere({
+			.pos = {4.0F, 1.0F, 0.0F},
+			.radius = 1.0F,
+			.materialId = material3
+		});
+	}
+
+	void initScaledScene(Scene &scene, u32 sphereCount, u32 seed)
+	{
+		Rng rng{seed};
+
+		const auto small = sphereCount > ScaledFixedSpheres ? sphereCount - ScaledFixedSpheres : 0;
+
+		// cells per side of the grid over [-11, 11), the last row is left partly empty
+		const auto side = static_cast<u32>(std::ceil(std::sqrt(static_cast<f64>(small))));
+		const auto cell = side > 0 ? 22.0F / static_cast<f32>(side) : 0.0F;
+		const auto radius = 0.2F * cell;
+
+		scene.reserve(sphereCount, ScaledMaterials + 4);
+
+		const auto groundMaterial = scene.createDiffuse({0.5F, 0.5F, 0.5F});
+		scene.createSphere({
+			.pos = {0.0F, -1000.0F, 0.0F},
+			.radius = 1000.0F,
+			.materialId = groundMaterial
+		});
+
+		const auto glass = scene.createDielectric({1.0F, 1.0F, 1.0F}, 1.52F);
+
+		// the same mix as the random scene
+		std::vector<u32> materials(ScaledMaterials);
+
+		for (auto &material : materials)
+		{
+			const auto materialSelector = rng.nextF32();
+
+			if (materialSelector < 0.8F)
+				material = scene.createDiffuse(rng.nextColor() * rng.nextColor());
+			else if (materialSelector < 0.95F)
+			{
+				const auto albedo = rng.nextColor() * 0.5F + 0.5F;
+				const auto fuzz = rng.nextF32() * 0.5F;
+
+				material = scene.createMetal(albedo, fuzz);
+			}
+			else material = glass;
+		}
+
+		std::vector<SphereData> spheres{};
+		spheres.reserve(small);
+
+		for (u32 i = 0; i < small; ++i)
+		{
+			const auto a = static_cast<f32>(i % side);
+			const auto b = static_cast<f32>(i / side);
+
+			spheres.push_back({
+				.pos = {
+					-11.0F + (a + 0.9F * rng.nextF32()) * cell,
+					radius,
+					-11.0F + (b + 0.9F * rng.nextF32()) * cell
+				},
+				.radius = radius,
+				.materialId = materials[rng.nextU32(ScaledMaterials)]
+			});
+		}
+
+		scene.createSpheres(spheres);
+
+		scene.createSphere({
+			.pos = {0.0F, 1.0F, 0.0F},
+			.radius = 1.0F,
+			.materialId = glass
+		});
+
+		const auto material2 = scene.createDiffuse({0.4F, 0.2F, 0.1F});
+		scene.createSphere({
+			.pos = {-4.0F, 1.0F, 0.0F},
+			.radius = 1.0F,
+			.materialId = material2
+		});
+
+		const auto material3 = scene.createMetal({0.7F, 0.6F, 0.5F}, 0.0F);
+		scene.createSphere({
+			.pos = {4.0F, 1.0F, 0.0F},
+			.radius = 1.0F,
+			.materialId = material3
+		});
+	}
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "types.h"
+
+#include "scene.h"
+
+namespace cpurt
+{
+	// returns the center sphere's index, for pointing the camera at
+	u32 initTestScene(Scene &scene);
+
+	// the final scene from ray tracing in one weekend
+	void initRandomScene(Scene &scene);
+
+	// the random scene's layout with sphereCount spheres in all: a finer grid of smaller
+	// spheres over the same area, sharing a fixed set of materials. seen from the same
+	// camera, so throughput can be compared as the scene grows
+	void initScaledScene(Scene &scene, u32 sphereCount, u32 seed);
+}
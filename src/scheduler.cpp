@@ -0,0 +1,353 @@
+#include "scheduler.h"
+
+#include <algorithm>
+
+namespace cpurt
+{
+	namespace
+	{
+		constexpr u64 CountMask = 0x7FFFFFFF;
+		constexpr u64 InterleavedFlag = u64{1} << 31;
+
+		// identifies the calling thread for spawn()
+		thread_local WorkStealingDeque *t_deque{};
+		thread_local const Scheduler *t_scheduler{};
+		thread_local u32 t_worker{Scheduler::NoWorker};
+	}
+
+	Scheduler::Scheduler(u32 threadCount, std::vector<CpuInfo> placement)
+		: m_threadCount{std::max(threadCount, 1U)}
+	{
+		m_jobs.push_back({.name = "default"});
+
+		m_workers.reserve(m_threadCount);
+
+		for (u32 i = 0; i < m_threadCount; ++i)
+		{
+			auto &worker = m_workers.emplace_back(std::make_unique<Worker>());
+
+			if (!placement.empty())
+			{
+				const auto &cpu = placement[i % placement.size()];
+
+				worker->cpu = cpu.id;
+				worker->node = cpu.node;
+			}
+		}
+
+		for (u32 i = 0; i < m_threadCount; ++i)
+		{
+			auto &victims = m_workers[i]->victims;
+
+			for (u32 j = 1; j < m_threadCount; ++j)
+			{
+				victims.push_back((i + j) % m_threadCount);
+			}
+
+			std::stable_partition(victims.begin(), victims.end(), [this, i](u32 victim)
+			{
+				return m_workers[victim]->node == m_workers[i]->node;
+			});
+		}
+
+		for (u32 i = 0; i < m_threadCount; ++i)
+		{
+			m_workers[i]->thread = std::thread{[this, i] { workerLoop(i); }};
+		}
+	}
+
+	Scheduler::~Scheduler()
+	{
+		m_exit.store(true, std::memory_order::release);
+
+		m_batch.fetch_add(GenerationIncrement, std::memory_order::release);
+		m_batch.notify_all();
+
+		// for threads waiting on spawned tasks that will never come
+		m_unclaimed.fetch_add(1, std::memory_order::release);
+		m_unclaimed.notify_all();
+
+		for (auto &worker : m_workers)
+		{
+			worker->thread.join();
+		}
+	}
+
+	Scheduler::JobId Scheduler::addJob(std::string name, i32 priority)
+	{
+		const std::lock_guard lock{m_jobMutex};
+
+		auto job = static_cast<JobId>(std::find_if(m_jobs.begin() + 1, m_jobs.end(), [](const Job &slot)
+		{
+			return slot.removed;
+		}) - m_jobs.begin());
+
+		if (job == m_jobs.size())
+			m_jobs.emplace_back();
+
+		m_jobs[job] = {.name = std::move(name), .priority = priority, .virtualTime = m_clock};
+
+		return job;
+	}
+
+	void Scheduler::removeJob(JobId job)
+	{
+		const std::lock_guard lock{m_jobMutex};
+
+		if (job != DefaultJob)
+			m_jobs[job].removed = true;
+	}
+
+	void Scheduler::priority(JobId job, i32 priority)
+	{
+		const std::lock_guard lock{m_jobMutex};
+		m_jobs[job].priority = priority;
+	}
+
+	Scheduler::JobStats Scheduler::stats(JobId job) const
+	{
+		const std::lock_guard lock{m_jobMutex};
+		return m_jobs[job].stats;
+	}
+
+	Scheduler::JobId Scheduler::nextJob() const
+	{
+		auto next = NoJob;
+
+		for (JobId job = 0; job < m_jobs.size(); ++job)
+		{
+			const auto &slot = m_jobs[job];
+
+			if (!slot.waiting)
+				continue;
+
+			if (next == NoJob || slot.priority > m_jobs[next].priority
+				|| (slot.priority == m_jobs[next].priority && slot.virtualTime < m_jobs[next].virtualTime))
+				next = job;
+		}
+
+		return next;
+	}
+
+	void Scheduler::start(u32 count, TaskFunc func, Distribution distribution, JobId job)
+	{
+		if (count == 0)
+			return;
+
+		{
+			std::unique_lock lock{m_jobMutex};
+
+			m_jobs[job].virtualTime = std::max(m_jobs[job].virtualTime, m_clock);
+			m_jobs[job].waiting = true;
+
+			m_jobReady.wait(lock, [this, job] { return m_owner == NoJob && nextJob() == job; });
+
+			m_jobs[job].waiting = false;
+
+			m_owner = job;
+			m_ownerTasks = count;
+			m_ownerTimer = Timer{};
+
+			m_clock = m_jobs[job].virtualTime;
+		}
+
+		m_func = std::move(func);
+
+		m_remaining.store(count, std::memory_order::relaxed);
+		m_unclaimed.store(count, std::memory_order::relaxed);
+
+		const auto generation = (m_batch.load(std::memory_order::relaxed) >> 32) + 1;
+
+		const auto flags = distribution == Distribution::Interleaved ? InterleavedFlag : 0;
+
+		m_batch.store((generation << 32) | flags | count, std::memory_order::release);
+		m_batch.notify_all();
+
+		m_unclaimed.notify_all();
+	}
+
+	u32 Scheduler::currentWorker() const
+	{
+		return t_scheduler == this ? t_worker : NoWorker;
+	}
+
+	bool Scheduler::spawn(u32 task)
+	{
+		if (!t_deque)
+			return false;
+
+		m_remaining.fetch_add(1, std::memory_order::relaxed);
+
+		// goes up before the push, so that nobody concludes the batch has run dry in between
+		if (m_unclaimed.fetch_add(1, std::memory_order::release) == 0)
+			m_unclaimed.notify_all();
+
+		t_deque->push(task);
+
+		return true;
+	}
+
+	u32 Scheduler::waitProgress(u32 remaining)
+	{
+		auto current = m_remaining.load(std::memory_order::acquire);
+
+		while (current >= remaining && current > 0)
+		{
+			m_remaining.wait(current, std::memory_order::acquire);
+			current = m_remaining.load(std::memory_order::acquire);
+		}
+
+		return current;
+	}
+
+	void Scheduler::wait(JobId job, bool another)
+	{
+		{
+			const std::lock_guard lock{m_jobMutex};
+
+			if (m_owner != job)
+				return;
+		}
+
+		auto current = m_remaining.load(std::memory_order::acquire);
+
+		while (current > 0)
+		{
+			m_remaining.wait(current, std::memory_order::acquire);
+			current = m_remaining.load(std::memory_order::acquire);
+		}
+
+		{
+			const std::lock_guard lock{m_jobMutex};
+
+			const auto time = m_ownerTimer.time();
+
+			auto &slot = m_jobs[job];
+
+			slot.stats.busyTime += time;
+			slot.stats.batches += 1;
+			slot.stats.tasks += m_ownerTasks;
+			slot.virtualTime += time;
+
+			// so that the pool doesn't go to someone else just for getting in before the next start()
+			slot.waiting = another;
+
+			m_owner = NoJob;
+		}
+
+		m_jobReady.notify_all();
+	}
+
+	void Scheduler::workerLoop(u32 id)
+	{
+		auto &deque = m_workers[id]->deque;
+
+		t_deque = &deque;
+		t_scheduler = this;
+		t_worker = id;
+
+		if (const auto cpu = m_workers[id]->cpu)
+			pinCurrentThread(*cpu);
+
+		u64 batch = 0;
+
+		while (true)
+		{
+			m_batch.wait(batch, std::memory_order::acquire);
+
+			// generation and task count are read together, a thread with an empty
+			// share can otherwise see the count of the batch after its own
+			batch = m_batch.load(std::memory_order::acquire);
+
+			if (m_exit.load(std::memory_order::acquire))
+				break;
+
+			const auto taskCount = static_cast<u32>(batch & CountMask);
+
+			// push this thread's share in reverse, so that popping from the
+			// bottom works through it in order while thieves take the far end
+			if (batch & InterleavedFlag)
+			{
+				if (id < taskCount)
+				{
+					auto i = id + (taskCount - 1 - id) / m_threadCount * m_threadCount;
+
+					while (true)
+					{
+						deque.push(i);
+
+						if (i < m_threadCount)
+							break;
+
+						i -= m_threadCount;
+					}
+				}
+			}
+			else
+			{
+				const auto begin = static_cast<u32>(static_cast<u64>(taskCount) * id / m_threadCount);
+				const auto end = static_cast<u32>(static_cast<u64>(taskCount) * (id + 1) / m_threadCount);
+
+				for (auto i = end; i-- > begin;)
+				{
+					deque.push(i);
+				}
+			}
+
+			u32 task;
+
+			while (findTask(id, batch, task))
+			{
+				m_func(task);
+
+				const auto remaining = m_remaining.fetch_sub(1, std::memory_order::acq_rel) - 1;
+
+				if (remaining == 0 || remaining % ProgressInterval == 0)
+					m_remaining.notify_all();
+			}
+		}
+	}
+
+	bool Scheduler::findTask(u32 id, u64 batch, u32 &task)
+	{
+		while (true)
+		{
+			if (const auto popped = m_workers[id]->deque.pop())
+			{
+				m_unclaimed.fetch_sub(1, std::memory_order::relaxed);
+				task = *popped;
+				return true;
+			}
+
+			// the next batch has already started, and this thread has to go
+			// back and push its share of that one before anyone can finish it
+			if (m_batch.load(std::memory_order::relaxed) != batch)
+				return false;
+
+			for (const auto victim : m_workers[id]->victims)
+			{
+				if (const auto stolen = m_workers[victim]->deque.steal())
+				{
+					m_unclaimed.fetch_sub(1, std::memory_order::relaxed);
+					task = *stolen;
+					return true;
+				}
+			}
+
+			if (m_unclaimed.load(std::memory_order::acquire) == 0)
+			{
+				if (m_remaining.load(std::memory_order::acquire) == 0)
+					return false;
+
+				// tasks still running may spawn more (and the next batch's start() also
+				// wakes this up, if the last task finishes without spawning anything)
+				m_unclaimed.wait(0, std::memory_order::acquire);
+				continue;
+			}
+
+			// everything left is either being stolen by someone else,
+			// or belongs to a thread that hasn't woken up yet
+			std::this_thread::yield();
+		}
+	}
+}
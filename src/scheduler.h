@@ -0,0 +1,184 @@
+#pragma once
+
+#include "types.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <optional>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+
+#include "deque.h"
+#include "topology.h"
+#include "timer.h"
+
+namespace cpurt
+{
+	// fixed pool of threads running batches of indexed tasks. every batch is split
+	// evenly over per-thread work-stealing deques, and idle threads steal from the
+	// others. nothing on the task path takes a lock; sleeping and completion both
+	// go through atomic wait/notify (a futex on linux).
+	//
+	// any number of jobs can share the pool, one batch at a time. whenever it frees up,
+	// the next batch goes to the highest priority job waiting to start one, and among
+	// those to the one that has held the pool for the least time, so jobs that keep
+	// their batches short interleave fairly
+	class Scheduler
+	{
+	public:
+		using TaskFunc = std::function<void (u32)>;
+
+		enum class Distribution : u32
+		{
+			// thread i starts on the i-th contiguous range of tasks
+			Contiguous = 0,
+			// thread i starts on tasks i, i + n, i + 2n, ... - for tasks sorted by cost
+			Interleaved
+		};
+
+		using JobId = u32;
+
+		// for work that doesn't register a job of its own
+		static constexpr JobId DefaultJob = 0;
+
+		struct JobStats
+		{
+			// seconds this job's batches held the pool
+			f64 busyTime;
+
+			u64 batches;
+			u64 tasks;
+		};
+
+		// with a placement, worker i is pinned to placement[i % size], and
+		// prefers stealing from workers on its own numa node
+		explicit Scheduler(u32 threadCount, std::vector<CpuInfo> placement = {});
+		~Scheduler();
+
+		Scheduler(const Scheduler &) = delete;
+		Scheduler &operator=(const Scheduler &) = delete;
+
+		[[nodiscard]] inline u32 threadCount() const { return m_threadCount; }
+
+		[[nodiscard]] inline u32 node(u32 worker) const { return m_workers[worker]->node; }
+
+		// the calling thread's worker index, or NoWorker if it isn't one of this scheduler's threads
+		[[nodiscard]] u32 currentWorker() const;
+
+		static constexpr u32 NoWorker = ~u32{0};
+
+		[[nodiscard]] inline std::optional<u32> cpu(u32 worker) const { return m_workers[worker]->cpu; }
+
+		// higher priorities always go first, the name is only for reporting
+		[[nodiscard]] JobId addJob(std::string name, i32 priority = 0);
+		void removeJob(JobId job);
+
+		void priority(JobId job, i32 priority);
+
+		[[nodiscard]] JobStats stats(JobId job) const;
+
+		// queues func(i) for every i in [0, count), after waiting for the pool if another
+		// job's batch is running. a job must wait() for its batch before starting another
+		void start(u32 count, TaskFunc func, Distribution distribution = Distribution::Contiguous,
+			JobId job = DefaultJob);
+
+		// from inside a running task only: adds task to the current batch, on the calling
+		// thread's deque where idle threads can steal it. returns false if called elsewhere
+		bool spawn(u32 task);
+
+		[[nodiscard]] inline u32 unclaimed() const
+		{
+			return m_unclaimed.load(std::memory_order::relaxed);
+		}
+
+		// blocks until the number of unfinished tasks in the current batch drops
+		// below remaining (woken at most every ProgressInterval tasks), and returns it.
+		// only for the job that started the batch
+		u32 waitProgress(u32 remaining);
+
+		// waits for job's batch and hands the pool on. returns right away if job isn't running one.
+		// with another, the job keeps its place in line for the batch it starts next
+		void wait(JobId job = DefaultJob, bool another = false);
+
+		inline void run(u32 count, TaskFunc func, Distribution distribution = Distribution::Contiguous,
+			JobId job = DefaultJob)
+		{
+			start(count, std::move(func), distribution, job);
+			wait(job);
+		}
+
+		static constexpr u32 ProgressInterval = 64;
+
+	private:
+		struct alignas(64) Worker
+		{
+			WorkStealingDeque deque{};
+			std::thread thread{};
+
+			std::optional<u32> cpu{};
+			u32 node{};
+
+			// every other worker, same node first
+			std::vector<u32> victims{};
+		};
+
+		struct Job
+		{
+			std::string name{};
+			i32 priority{};
+
+			JobStats stats{};
+
+			// busy time, but never behind the job the pool last went to when this one starts
+			// waiting, so a job that sat idle doesn't get to make up for the time it didn't use
+			f64 virtualTime{};
+
+			bool waiting{false};
+			bool removed{false};
+		};
+
+		static constexpr JobId NoJob = ~JobId{0};
+
+		// the waiting job whose turn it is, or NoJob
+		[[nodiscard]] JobId nextJob() const;
+
+		void workerLoop(u32 id);
+
+		[[nodiscard]] bool findTask(u32 id, u64 batch, u32 &task);
+
+		u32 m_threadCount;
+
+		std::vector<std::unique_ptr<Worker>> m_workers{};
+
+		static constexpr u64 GenerationIncrement = u64{1} << 32;
+
+		TaskFunc m_func{};
+
+		// generation in the upper half, task count in the lower. the
+		// generation is bumped to start a batch, or to shut down
+		alignas(64) std::atomic<u64> m_batch{0};
+		std::atomic<bool> m_exit{false};
+
+		// tasks not yet taken from any deque (including shares not yet pushed by their owner)
+		alignas(64) std::atomic<u32> m_unclaimed{0};
+
+		// tasks not yet finished
+		alignas(64) std::atomic<u32> m_remaining{0};
+
+		// indexed by id, removed slots get reused
+		std::vector<Job> m_jobs{};
+
+		JobId m_owner{NoJob};
+		u32 m_ownerTasks{};
+		Timer m_ownerTimer{};
+
+		f64 m_clock{};
+
+		mutable std::mutex m_jobMutex{};
+		std::condition_variable m_jobReady{};
+	};
+}
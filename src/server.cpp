@@ -0,0 +1,567 @@
+#include "server.h"
+
+#include <iostream>
+#include <sstream>
+#include <string_view>
+#include <algorithm>
+#include <unordered_map>
+#include <memory>
+#include <vector>
+#include <array>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <csignal>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "scene.h"
+#include "scenes.h"
+#include "camera.h"
+#include "framebuffer.h"
+#include "output.h"
+#include "timer.h"
+#include "net.h"
+#include "parse.h"
+
+namespace cpurt
+{
+	namespace
+	{
+		constexpr u32 MaxDimension = 16384;
+
+		enum class ReplyFormat : u32
+		{
+			Png = 0,
+			Rgba,
+			Hdr,
+			Accum
+		};
+
+		struct RenderRequest
+		{
+			std::string scene{"random"};
+
+			u32 width{Width}, height{Height};
+
+			// part of the image to render, the whole image if empty
+			u32 regionX{}, regionY{}, regionWidth{}, regionHeight{};
+
+			u32 samples{Samples};
+			u32 passSamples{0};
+
+			// render samples [firstSample, firstSample + samples) of each pixel
+			u32 firstSample{0};
+
+			u32 seed{0};
+
+			// milliseconds, 0 for none
+			f64 deadline{0.0};
+
+			// of this client's renders against other clients'
+			i32 priority{0};
+
+			glm::vec3 pos{13.0F, 2.0F, 3.0F};
+			glm::vec3 target{0.0F, 0.0F, 0.0F};
+
+			f32 fov{20.0F};
+			f32 aperture{0.1F};
+			f32 focus{10.0F};
+
+			ReplyFormat format{ReplyFormat::Png};
+		};
+
+		bool parseVec3(std::string_view str, glm::vec3 &value)
+		{
+			for (i32 i = 0; i < 3; ++i)
+			{
+				const auto comma = str.find(',');
+
+				if ((comma == std::string_view::npos) != (i == 2)
+					|| !parseNumber(str.substr(0, comma), value[i]))
+					return false;
+
+				if (i < 2)
+					str.remove_prefix(comma + 1);
+			}
+
+			return true;
+		}
+
+		bool parseRegion(std::string_view str, RenderRequest &request)
+		{
+			u32 *values[] = {&request.regionX, &request.regionY, &request.regionWidth, &request.regionHeight};
+
+			for (u32 i = 0; i < 4; ++i)
+			{
+				const auto comma = str.find(',');
+
+				if ((comma == std::string_view::npos) != (i == 3)
+					|| !parseNumber(str.substr(0, comma), *values[i]))
+					return false;
+
+				if (i < 3)
+					str.remove_prefix(comma + 1);
+			}
+
+			return true;
+		}
+
+		bool parseFormat(std::string_view str, ReplyFormat &format)
+		{
+			if (str == "png")
+				format = ReplyFormat::Png;
+			else if (str == "rgba")
+				format = ReplyFormat::Rgba;
+			else if (str == "hdr")
+				format = ReplyFormat::Hdr;
+			else if (str == "accum")
+				format = ReplyFormat::Accum;
+			else return false;
+
+			return true;
+		}
+
+		constexpr std::string_view formatName(ReplyFormat format)
+		{
+			switch (format)
+			{
+			case ReplyFormat::Png: return "png";
+			case ReplyFormat::Rgba: return "rgba";
+			case ReplyFormat::Hdr: return "hdr";
+			case ReplyFormat::Accum: return "accum";
+			}
+
+			return "unknown";
+		}
+
+		// fills in request, or returns an error message
+		std::string parseRenderRequest(std::istringstream &args, RenderRequest &request)
+		{
+			std::string arg{};
+
+			while (args >> arg)
+			{
+				const auto eq = arg.find('=');
+
+				if (eq == std::string::npos)
+					return "expected key=value, got " + arg;
+
+				const std::string_view key{arg.data(), eq};
+				const std::string_view value{arg.data() + eq + 1, arg.size() - eq - 1};
+
+				bool valid;
+
+				if (key == "scene")
+					valid = (request.scene = value, true);
+				else if (key == "width")
+					valid = parseNumber(value, request.width);
+				else if (key == "height")
+					valid = parseNumber(value, request.height);
+				else if (key == "samples")
+					valid = parseNumber(value, request.samples);
+				else if (key == "first-sample")
+					valid = parseNumber(value, request.firstSample);
+				else if (key == "region")
+					valid = parseRegion(value, request);
+				else if (key == "pass-samples")
+					valid = parseNumber(value, request.passSamples);
+				else if (key == "deadline")
+					valid = parseNumber(value, request.deadline) && request.deadline >= 0.0;
+				else if (key == "priority")
+					valid = parseNumber(value, request.priority);
+				else if (key == "seed")
+					valid = parseNumber(value, request.seed);
+				else if (key == "pos")
+					valid = parseVec3(value, request.pos);
+				else if (key == "target")
+					valid = parseVec3(value, request.target);
+				else if (key == "fov")
+					valid = parseNumber(value, request.fov);
+				else if (key == "aperture")
+					valid = parseNumber(value, request.aperture);
+				else if (key == "focus")
+					valid = parseNumber(value, request.focus);
+				else if (key == "format")
+					valid = parseFormat(value, request.format);
+				else return "unknown argument " + std::string{key};
+
+				if (!valid)
+					return "invalid value for " + std::string{key};
+			}
+
+			if (request.width == 0 || request.height == 0
+				|| request.width > MaxDimension || request.height > MaxDimension)
+				return "invalid resolution";
+
+			if (request.samples == 0 || request.samples > ~u32{0} - request.firstSample)
+				return "invalid sample count";
+
+			if (request.regionWidth == 0 || request.regionHeight == 0)
+			{
+				request.regionX = 0;
+				request.regionY = 0;
+				request.regionWidth = request.width;
+				request.regionHeight = request.height;
+			}
+			else if (request.regionX >= request.width || request.regionY >= request.height
+				|| request.regionWidth > request.width - request.regionX
+				|| request.regionHeight > request.height - request.regionY)
+				return "region outside the image";
+
+			return {};
+		}
+
+		// every scene a client can ask for, whether it's been built yet or not
+		constexpr std::array<std::string_view, 2> SceneNames{"random", "test"};
+
+		// loaded on first use and kept for every client after
+		class SceneCache
+		{
+		public:
+			// nullptr for an unknown name
+			const Scene *get(const std::string &name)
+			{
+				// a client asking for a scene still being built waits for it
+				const std::lock_guard lock{m_mutex};
+
+				if (const auto found = m_scenes.find(name); found != m_scenes.end())
+					return found->second.get();
+
+				auto scene = std::make_unique<Scene>();
+
+				if (name == "random")
+					initRandomScene(*scene);
+				else if (name == "test")
+					(void)initTestScene(*scene);
+				else return nullptr;
+
+				scene->buildBvh();
+
+				return m_scenes.emplace(name, std::move(scene)).first->second.get();
+			}
+
+			std::string names() const
+			{
+				std::string names{};
+
+				for (const auto name : SceneNames)
+				{
+					names += ' ';
+					names += name;
+				}
+
+				return names;
+			}
+
+		private:
+			mutable std::mutex m_mutex{};
+			std::unordered_map<std::string, std::unique_ptr<Scene>> m_scenes{};
+		};
+
+		// one client's connection
+		class Server
+		{
+		public:
+			Server(Renderer &renderer, const PostSettings &post, SceneCache &scenes)
+				: m_renderer{renderer},
+				  m_post{post},
+				  m_scenes{scenes} {}
+
+			// false once the server should stop
+			bool serve(Connection &connection)
+			{
+				std::string line{};
+
+				while (connection.readLine(line))
+				{
+					std::istringstream args{line};
+
+					std::string command{};
+					args >> command;
+
+					if (command.empty())
+						continue;
+
+					if (command == "quit")
+						return true;
+					else if (command == "shutdown")
+						return false;
+					else if (command == "scenes")
+					{
+						if (!connection.write("scenes" + m_scenes.names() + '\n'))
+							return true;
+					}
+					else if (command == "render")
+					{
+						if (!render(connection, args))
+							return true;
+					}
+					else if (!connection.write("error unknown command " + command + '\n'))
+						return true;
+				}
+
+				return true;
+			}
+
+		private:
+			// false if the client went away
+			bool render(Connection &connection, std::istringstream &args)
+			{
+				RenderRequest request{};
+
+				if (const auto error = parseRenderRequest(args, request); !error.empty())
+					return connection.write("error " + error + '\n');
+
+				const auto *scene = m_scenes.get(request.scene);
+
+				if (!scene)
+					return connection.write("error unknown scene " + request.scene + '\n');
+
+				Timer timer{};
+
+				m_renderer.priority(request.priority);
+
+				Camera camera{request.width, request.height, request.fov, request.aperture, request.focus};
+
+				camera.pos() = request.pos;
+				camera.target() = request.target;
+
+				camera.update();
+
+				Framebuffer framebuffer{request.regionWidth, request.regionHeight, request.seed};
+
+				framebuffer.originX = request.regionX;
+				framebuffer.originY = request.regionY;
+
+				// picks up the random streams where a render of the first samples left off
+				framebuffer.firstSample = request.firstSample;
+
+				const auto totalSamples = request.samples;
+
+				const ProgressiveSettings settings{
+					.totalSamples = totalSamples,
+					.passSamples = request.passSamples > 0 ? request.passSamples : request.samples,
+					.snapshotInterval = 0.0,
+					.snapshotPasses = request.passSamples > 0 ? 1U : 0U
+				};
+
+				if (request.deadline > 0.0)
+				{
+					const auto job = m_renderer.drawAsync(*scene, camera, framebuffer, {
+						.totalSamples = totalSamples,
+						.maxPassSamples = request.passSamples > 0 ? request.passSamples : AsyncSettings{}.maxPassSamples,
+						.deadline = request.deadline / 1000.0
+					});
+
+					const auto result = job.wait();
+
+					if (!sendImage(connection, framebuffer, result.minSamples, request.format))
+						return false;
+
+					std::ostringstream done{};
+					done << "done " << (timer.time() * 1000.0) << '\n';
+
+					return connection.write(done.str());
+				}
+
+				bool connected = true;
+
+				m_renderer.drawProgressive(*scene, camera, framebuffer, settings,
+					[&](const Framebuffer &current, u32 samples)
+					{
+						if (connected)
+							connected = sendImage(connection, current, samples, request.format);
+					});
+
+				if (!connected || !sendImage(connection, framebuffer, totalSamples, request.format))
+					return false;
+
+				std::ostringstream done{};
+				done << "done " << (timer.time() * 1000.0) << '\n';
+
+				return connection.write(done.str());
+			}
+
+			bool sendImage(Connection &connection, const Framebuffer &framebuffer, u32 samples, ReplyFormat format)
+			{
+				if (format == ReplyFormat::Accum)
+					return sendAccumulation(connection, framebuffer, samples);
+
+				m_renderer.develop(framebuffer, m_image);
+
+				const void *payload;
+				std::size_t size;
+
+				if (format == ReplyFormat::Hdr)
+				{
+					payload = m_image.pixels.data();
+					size = m_image.pixels.size() * sizeof(glm::vec3);
+				}
+				else
+				{
+					m_pixels.resize(m_image.pixels.size());
+					m_renderer.resolve(m_image, m_post, m_pixels.data());
+
+					if (format == ReplyFormat::Png)
+					{
+						if (!encodePng(m_image.width, m_image.height, m_pixels.data(), m_encoded))
+							return connection.write("error failed to encode png\n");
+
+						payload = m_encoded.data();
+						size = m_encoded.size();
+					}
+					else
+					{
+						payload = m_pixels.data();
+						size = m_pixels.size() * sizeof(u32);
+					}
+				}
+
+				std::ostringstream header{};
+				header << "image " << m_image.width << ' ' << m_image.height << ' ' << samples
+					<< ' ' << formatName(format) << ' ' << size << '\n';
+
+				return connection.write(header.str()) && connection.write(payload, size);
+			}
+
+			// raw sums and sample counts (of this render's samples only), for merging elsewhere
+			bool sendAccumulation(Connection &connection, const Framebuffer &framebuffer, u32 samples)
+			{
+				const auto colorSize = framebuffer.color.size() * sizeof(glm::vec3);
+				const auto samplesSize = framebuffer.samples.size() * sizeof(u32);
+
+				std::ostringstream header{};
+				header << "image " << framebuffer.width << ' ' << framebuffer.height << ' ' << samples
+					<< " accum " << (colorSize + samplesSize) << '\n';
+
+				return connection.write(header.str())
+					&& connection.write(framebuffer.color.data(), colorSize)
+					&& connection.write(framebuffer.samples.data(), samplesSize);
+			}
+
+			Renderer &m_renderer;
+			PostSettings m_post;
+
+			SceneCache &m_scenes;
+
+			// reused between jobs
+			HdrImage m_image{};
+			std::vector<u32> m_pixels{};
+			std::vector<u8> m_encoded{};
+		};
+	}
+
+	i32 runServer(const std::string &path, const Options &options)
+	{
+		// a client disconnecting mid-reply shows up as a failed write instead
+		std::signal(SIGPIPE, SIG_IGN);
+
+		// stdout carries replies
+		if (path == "-")
+			std::cout.rdbuf(std::cerr.rdbuf());
+
+		SceneCache scenes{};
+
+		// a renderer per client, so each one is a job of its own on the shared pool
+		const auto serveClient = [&](Connection &connection, const std::string &name)
+		{
+			Renderer renderer{name};
+			renderer.tileOrder(options.tileOrder);
+			renderer.pixelOrder(options.pixelOrder);
+
+			Server server{renderer, options.post, scenes};
+
+			return server.serve(connection);
+		};
+
+		if (path == "-")
+		{
+			Connection connection{STDIN_FILENO, STDOUT_FILENO};
+			serveClient(connection, "client");
+
+			return 0;
+		}
+
+		const auto listener = listenOn(path);
+
+		if (listener < 0)
+			return 1;
+
+		std::cout << "listening on " << path << std::endl;
+
+		std::atomic<bool> running{true};
+
+		struct Client
+		{
+			std::thread thread{};
+			std::atomic<bool> done{false};
+		};
+
+		// joined rather than detached, so that none outlives the state it uses
+		std::list<Client> clients{};
+
+		u32 clientCount = 0;
+
+		// every client on a thread of its own, their renders interleave on the pool
+		while (running.load(std::memory_order::acquire))
+		{
+			const auto client = accept(listener, nullptr, nullptr);
+
+			if (client < 0)
+			{
+				if (errno == EINTR)
+					continue;
+
+				// shut down by a client
+				if (!running.load(std::memory_order::acquire))
+					break;
+
+				std::cerr << "accept failed: " << std::strerror(errno) << std::endl;
+				break;
+			}
+
+			// clean up after the ones that have disconnected
+			std::erase_if(clients, [](Client &entry)
+			{
+				if (!entry.done.load(std::memory_order::acquire))
+					return false;
+
+				entry.thread.join();
+				return true;
+			});
+
+			auto &entry = clients.emplace_back();
+
+			entry.thread = std::thread{[&, &done = entry.done, client, name = "client " + std::to_string(++clientCount)]
+			{
+				Connection connection{client};
+
+				if (!serveClient(connection, name))
+				{
+					running.store(false, std::memory_order::release);
+
+					// wakes up accept
+					::shutdown(listener, SHUT_RDWR);
+				}
+
+				close(client);
+
+				done.store(true, std::memory_order::release);
+			}};
+		}
+
+		// the other clients get to finish
+		for (auto &entry : clients)
+		{
+			entry.thread.join();
+		}
+
+		closeListener(listener, path);
+
+		return 0;
+	}
+}
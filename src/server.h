@@ -0,0 +1,36 @@
+#pragma once
+
+#include "types.h"
+
+#include <string>
+
+#include "options.h"
+
+namespace cpurt
+{
+	// keeps scenes (with their bvhs) and the worker pool alive across jobs. clients are
+	// served concurrently, each with a renderer of its own sharing the pool (see Renderer).
+	// text protocol, one request per line with key=value arguments:
+	//
+	//   render [scene=random|test] [width=] [height=] [samples=] [pass-samples=] [seed=]
+	//          [pos=x,y,z] [target=x,y,z] [fov=] [aperture=] [focus=] [format=png|rgba|hdr|accum]
+	//          [region=x,y,w,h] [first-sample=] [deadline=<ms>] [priority=]
+	//     replies "image <width> <height> <spp> <format> <bytes>\n" and the payload, after
+	//     every pass-samples samples if given and once at the end, then "done <ms>\n".
+	//     rgba is 8 bit rgba and hdr is linear f32 rgb, top row first, native byte order.
+	//     accum is the raw per-pixel f32 rgb sums followed by the u32 sample counts.
+	//     region renders part of a width x height image, and first-sample continues
+	//     each pixel's random stream from that many samples in. spp and the accum
+	//     counts only cover the samples rendered by this request.
+	//     with a deadline, rendering stops when it runs out and only the final image is
+	//     sent. its spp is the lowest over all pixels, accum has the exact counts.
+	//     priority (default 0) ranks the render against other clients', higher goes first
+	//   scenes    replies "scenes <name>...\n", listing the scenes render can use
+	//   quit      closes the connection
+	//   shutdown  closes the connection and stops accepting clients, the server
+	//             exits once the others have disconnected
+	//
+	// failed requests reply "error <message>\n". serves on a socket address (see net.h),
+	// or stdin/stdout if path is "-" (log output then goes to stderr)
+	i32 runServer(const std::string &path, const Options &options);
+}
@@ -0,0 +1,173 @@
+#include "sharedimage.h"
+
+#include <iostream>
+#include <atomic>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "config.h"
+
+namespace cpurt
+{
+	namespace
+	{
+		// pixels start on their own cache line
+		constexpr std::size_t PixelAlignment = 64;
+
+		inline std::size_t pixelSize(SharedImageFormat format)
+		{
+			return format == SharedImageFormat::RgbF32 ? sizeof(glm::vec3) : sizeof(u32);
+		}
+	}
+
+	SharedImage::~SharedImage()
+	{
+		if (m_header)
+			munmap(m_header, m_size);
+	}
+
+	bool SharedImage::open(const std::string &name, SharedImageFormat format, u32 width, u32 height, const PostSettings &post)
+	{
+		const auto tilesX = (width + TileSize - 1) / TileSize;
+		const auto tilesY = (height + TileSize - 1) / TileSize;
+
+		const auto tableEnd = sizeof(SharedImageHeader) + static_cast<std::size_t>(tilesX) * tilesY * sizeof(u32);
+		const auto pixelOffset = (tableEnd + PixelAlignment - 1) / PixelAlignment * PixelAlignment;
+
+		const auto size = pixelOffset + static_cast<std::size_t>(width) * height * pixelSize(format);
+
+		const bool sharedMemory = name.size() > 1 && name[0] == '/' && name.find('/', 1) == std::string::npos;
+
+		const auto fd = sharedMemory
+			? shm_open(name.c_str(), O_RDWR | O_CREAT, 0644)
+			: ::open(name.c_str(), O_RDWR | O_CREAT, 0644);
+
+		if (fd < 0)
+		{
+			std::cerr << "failed to open shared image " << name << ": " << std::strerror(errno) << std::endl;
+			return false;
+		}
+
+		if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+		{
+			std::cerr << "failed to resize shared image " << name << ": " << std::strerror(errno) << std::endl;
+			close(fd);
+			return false;
+		}
+
+		auto *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+		// the mapping keeps the object alive
+		close(fd);
+
+		if (ptr == MAP_FAILED)
+		{
+			std::cerr << "failed to map shared image " << name << ": " << std::strerror(errno) << std::endl;
+			return false;
+		}
+
+		if (m_header)
+			munmap(m_header, m_size);
+
+		m_header = static_cast<SharedImageHeader *>(ptr);
+		m_generations = reinterpret_cast<u32 *>(m_header + 1);
+		m_pixels = static_cast<u8 *>(ptr) + pixelOffset;
+		m_size = size;
+
+		m_post = post;
+		m_exposureScale = std::exp2(post.exposure);
+
+		// whatever a previous render left there stops being valid first
+		std::atomic_ref{m_header->magic}.store(0, std::memory_order::release);
+
+		m_header->version = SharedImageVersion;
+		m_header->width = width;
+		m_header->height = height;
+		m_header->format = format;
+		m_header->tileSize = TileSize;
+		m_header->tilesX = tilesX;
+		m_header->tilesY = tilesY;
+		m_header->pixelOffset = static_cast<u32>(pixelOffset);
+		m_header->complete = 0;
+
+		std::memset(m_generations, 0, static_cast<std::size_t>(tilesX) * tilesY * sizeof(u32));
+		std::memset(m_pixels, 0, size - pixelOffset);
+
+		std::atomic_ref{m_header->magic}.store(SharedImageMagic, std::memory_order::release);
+
+		return true;
+	}
+
+	void SharedImage::publish(const Framebuffer &framebuffer, u32 startX, u32 endX, u32 startY, u32 endY)
+	{
+		for (u32 y = startY; y < endY; ++y)
+		{
+			for (u32 x = startX; x < endX; ++x)
+			{
+				const auto idx = y * framebuffer.width + x;
+
+				const auto samples = framebuffer.samples[idx];
+				const auto invSamples = samples == 0 ? 0.0F : 1.0F / static_cast<f32>(samples);
+
+				store(framebuffer.originX + x, framebuffer.originY + y, framebuffer.color[idx] * invSamples);
+			}
+		}
+
+		publishTiles(framebuffer.originX + startX, framebuffer.originX + endX,
+			framebuffer.originY + startY, framebuffer.originY + endY);
+	}
+
+	void SharedImage::finish(const HdrImage &image)
+	{
+		for (u32 y = 0; y < image.height; ++y)
+		{
+			for (u32 x = 0; x < image.width; ++x)
+			{
+				store(x, y, image.pixels[y * image.width + x]);
+			}
+		}
+
+		publishTiles(0, image.width, 0, image.height);
+		finish();
+	}
+
+	void SharedImage::finish()
+	{
+		std::atomic_ref{m_header->complete}.store(1, std::memory_order::release);
+	}
+
+	void SharedImage::publishTiles(u32 startX, u32 endX, u32 startY, u32 endY)
+	{
+		if (startX >= endX || startY >= endY)
+			return;
+
+		const auto tilesX = m_header->tilesX;
+
+		for (u32 tileY = startY / TileSize; tileY <= (endY - 1) / TileSize; ++tileY)
+		{
+			for (u32 tileX = startX / TileSize; tileX <= (endX - 1) / TileSize; ++tileX)
+			{
+				std::atomic_ref{m_generations[tileY * tilesX + tileX]}.fetch_add(1, std::memory_order::release);
+			}
+		}
+	}
+
+	void SharedImage::store(u32 x, u32 y, glm::vec3 color)
+	{
+		const auto idx = static_cast<std::size_t>(y) * m_header->width + x;
+
+		if (m_header->format == SharedImageFormat::RgbF32)
+			std::memcpy(m_pixels + idx * sizeof(glm::vec3), &color, sizeof(glm::vec3));
+		else
+		{
+			const auto pixel = developPixel(color, m_post, m_exposureScale);
+			std::memcpy(m_pixels + idx * sizeof(u32), &pixel, sizeof(u32));
+		}
+	}
+}
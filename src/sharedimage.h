@@ -0,0 +1,93 @@
+#pragma once
+
+#include "types.h"
+
+#include <string>
+#include <cstddef>
+
+#include "framebuffer.h"
+#include "postprocess.h"
+
+// an image in shared memory (or a memory mapped file) that other local processes
+// can read tiles of while they are still being rendered, without copies or encoding.
+//
+// the mapping starts with a SharedImageHeader, followed by one u32 generation per
+// tile (row major, tilesX * tilesY of them), followed at pixelOffset by the pixels
+// in tightly packed rows. all fields are native endian.
+//
+// a consumer waits for magic to read SharedImageMagic (acquire), then polls the
+// generations (acquire) and reads every tile whose generation changed. a tile
+// rendered over in a later pass may be read halfway through, and is then a mix of
+// the two passes' pixels. complete is set (release) once the final image is in
+namespace cpurt
+{
+	enum class SharedImageFormat : u32
+	{
+		// resolved 8 bit rgba, the same as the output image
+		Rgba8 = 0,
+		// linear, averaged 32-bit float rgb, before post-processing
+		RgbF32,
+		_last
+	};
+
+	constexpr u32 SharedImageMagic = 0x54524350; // "PCRT"
+	constexpr u32 SharedImageVersion = 1;
+
+	struct SharedImageHeader
+	{
+		u32 magic;
+		u32 version;
+
+		u32 width, height;
+		SharedImageFormat format;
+
+		u32 tileSize;
+		u32 tilesX, tilesY;
+
+		// from the start of the mapping
+		u32 pixelOffset;
+
+		u32 complete;
+	};
+
+	class SharedImage
+	{
+	public:
+		SharedImage() = default;
+		~SharedImage();
+
+		SharedImage(const SharedImage &) = delete;
+		SharedImage &operator=(const SharedImage &) = delete;
+
+		// names starting with a / (and containing no other) are posix shared memory objects,
+		// anything else is a file. either is created or resized to fit, and left behind
+		// afterwards for consumers to read. returns false, after printing why, on failure
+		bool open(const std::string &name, SharedImageFormat format, u32 width, u32 height, const PostSettings &post);
+
+		// writes a finished region of the framebuffer, in framebuffer pixels, and bumps its tiles.
+		// safe to call from several threads for different regions
+		void publish(const Framebuffer &framebuffer, u32 startX, u32 endX, u32 startY, u32 endY);
+
+		// writes the final (possibly denoised) image over everything, and marks it complete
+		void finish(const HdrImage &image);
+
+		// marks the image complete as it is, when the whole image never exists at once
+		void finish();
+
+		[[nodiscard]] inline bool valid() const { return m_header != nullptr; }
+
+	private:
+		void publishTiles(u32 startX, u32 endX, u32 startY, u32 endY);
+
+		void store(u32 x, u32 y, glm::vec3 color);
+
+		SharedImageHeader *m_header{};
+		u32 *m_generations{};
+		u8 *m_pixels{};
+
+		std::size_t m_size{};
+
+		PostSettings m_post{};
+		f32 m_exposureScale{1.0F};
+	};
+}
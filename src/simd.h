@@ -0,0 +1,158 @@
+#pragma once
+
+#include "types.h"
+
+#include <cmath>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+// hot kernels are built once per isa level in portable builds, and the best one
+// the cpu supports gets picked when the program loads (through an ifunc). everything
+// they inline is compiled along with them. native builds only target the host anyway
+#if defined(CPURT_PORTABLE) && defined(__x86_64__)
+#define CPURT_KERNEL __attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+#else
+#define CPURT_KERNEL
+#endif
+
+namespace cpurt::simd
+{
+	// the variant of the kernels this cpu runs, for logging
+	[[nodiscard]] inline const char *kernelIsa()
+	{
+#if defined(CPURT_PORTABLE) && defined(__x86_64__)
+		if (__builtin_cpu_supports("x86-64-v4"))
+			return "x86-64-v4 (avx-512)";
+		if (__builtin_cpu_supports("x86-64-v3"))
+			return "x86-64-v3 (avx2)";
+
+		return "baseline";
+#else
+		return "native";
+#endif
+	}
+
+	// gcc/clang vector extensions - lowered to whatever the target isa provides,
+	// and the same templated kernels can be instantiated for f32 and f32x8
+	using f32x8 = f32 __attribute__((vector_size(32)));
+	using u32x8 = u32 __attribute__((vector_size(32)));
+	using i32x8 = i32 __attribute__((vector_size(32)));
+
+	using f32x16 = f32 __attribute__((vector_size(64)));
+	using u32x16 = u32 __attribute__((vector_size(64)));
+	using i32x16 = i32 __attribute__((vector_size(64)));
+
+	template <typename T>
+	struct FloatVector;
+
+	template <>
+	struct FloatVector<u32x8>
+	{
+		using Type = f32x8;
+	};
+
+	template <>
+	struct FloatVector<u32x16>
+	{
+		using Type = f32x16;
+	};
+
+	template <typename T>
+	constexpr u32 Width = sizeof(T) / sizeof(f32);
+
+	template <typename T>
+	[[nodiscard]] inline T splat(f32 v)
+	{
+		if constexpr(std::is_same_v<T, f32>)
+			return v;
+		else return T{} + v;
+	}
+
+	[[nodiscard]] inline f32 sqrt(f32 v)
+	{
+		return std::sqrt(v);
+	}
+
+	[[nodiscard]] inline f32x8 sqrt(f32x8 v)
+	{
+#ifdef __AVX__
+		return _mm256_sqrt_ps(v);
+#else
+		for (u32 i = 0; i < Width<f32x8>; ++i)
+		{
+			v[i] = std::sqrt(v[i]);
+		}
+
+		return v;
+#endif
+	}
+
+	[[nodiscard]] inline f32x16 sqrt(f32x16 v)
+	{
+#ifdef __AVX512F__
+		return _mm512_sqrt_ps(v);
+#else
+		for (u32 i = 0; i < Width<f32x16>; ++i)
+		{
+			v[i] = std::sqrt(v[i]);
+		}
+
+		return v;
+#endif
+	}
+
+	template <typename T>
+	[[nodiscard]] inline T abs(T v)
+	{
+		return v < 0.0F ? -v : v;
+	}
+
+	template <typename T>
+	[[nodiscard]] inline T min(T a, T b)
+	{
+		return a < b ? a : b;
+	}
+
+	template <typename T>
+	[[nodiscard]] inline T max(T a, T b)
+	{
+		return a > b ? a : b;
+	}
+
+	template <typename T>
+	[[nodiscard]] inline auto toF32(T v)
+	{
+		return __builtin_convertvector(v, typename FloatVector<T>::Type);
+	}
+
+	template <u32 Amount, typename T>
+	[[nodiscard]] inline T rotl(T v)
+	{
+		return (v << Amount) | (v >> (32 - Amount));
+	}
+
+	constexpr f32 Pi = 3.14159265358979323846F;
+	constexpr f32 HalfPi = Pi / 2.0F;
+	constexpr f32 QuarterPi = Pi / 4.0F;
+
+	// sin(x) for x in [-pi/2, pi/2], taylor to x^11 (|err| < 1e-7 in range)
+	template <typename T>
+	[[nodiscard]] inline T sinPoly(T x)
+	{
+		const auto x2 = x * x;
+		return x * (1.0F + x2 * (-1.0F / 6.0F + x2 * (1.0F / 120.0F + x2 * (-1.0F / 5040.0F
+			+ x2 * (1.0F / 362880.0F + x2 * (-1.0F / 39916800.0F))))));
+	}
+
+	// branch-free sin and cos for x in [-pi, pi]
+	template <typename T>
+	inline void sincos(T x, T &s, T &c)
+	{
+		const auto folded = x > HalfPi ? Pi - x : x < -HalfPi ? -Pi - x : x;
+
+		s = sinPoly(folded);
+		c = sinPoly(HalfPi - abs(x));
+	}
+}
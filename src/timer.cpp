@@ -25,7 +25,7 @@ namespace cpurt
 	}
 }
 #else // assume posix, untested
-#include <unistd.h>
+#include <time.h>
 
 namespace cpurt
 {
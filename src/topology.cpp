@@ -0,0 +1,150 @@
+#include "topology.h"
+
+#include <fstream>
+#include <string>
+#include <filesystem>
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+
+#include <sched.h>
+
+namespace cpurt
+{
+	namespace
+	{
+		// "0-3,8,10-11"
+		std::vector<u32> parseCpuList(const std::string &list)
+		{
+			std::vector<u32> cpus{};
+
+			const auto *ptr = list.data();
+			const auto *end = ptr + list.size();
+
+			while (ptr < end)
+			{
+				u32 first{}, last{};
+
+				auto result = std::from_chars(ptr, end, first);
+
+				if (result.ec != std::errc{})
+					break;
+
+				ptr = result.ptr;
+				last = first;
+
+				if (ptr < end && *ptr == '-')
+				{
+					result = std::from_chars(ptr + 1, end, last);
+
+					if (result.ec != std::errc{})
+						break;
+
+					ptr = result.ptr;
+				}
+
+				for (auto cpu = first; cpu <= last; ++cpu)
+				{
+					cpus.push_back(cpu);
+				}
+
+				if (ptr < end && *ptr == ',')
+					++ptr;
+				else break;
+			}
+
+			return cpus;
+		}
+	}
+
+	std::vector<CpuInfo> availableCpus()
+	{
+		cpu_set_t set{};
+		CPU_ZERO(&set);
+
+		if (sched_getaffinity(0, sizeof(set), &set) != 0)
+			return {};
+
+		std::vector<CpuInfo> cpus{};
+
+		for (u32 cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+		{
+			if (CPU_ISSET(cpu, &set))
+				cpus.push_back({.id = cpu, .node = 0});
+		}
+
+		// kernel node numbers, in ascending order
+		std::vector<std::pair<u32, std::vector<u32>>> nodes{};
+
+		std::error_code error{};
+
+		for (const auto &entry : std::filesystem::directory_iterator{"/sys/devices/system/node", error})
+		{
+			const auto name = entry.path().filename().string();
+
+			if (!name.starts_with("node"))
+				continue;
+
+			u32 node{};
+			const auto [ptr, ec] = std::from_chars(name.data() + 4, name.data() + name.size(), node);
+
+			if (ec != std::errc{} || ptr != name.data() + name.size())
+				continue;
+
+			std::ifstream stream{entry.path() / "cpulist"};
+			std::string list{};
+
+			if (std::getline(stream, list))
+				nodes.emplace_back(node, parseCpuList(list));
+		}
+
+		std::sort(nodes.begin(), nodes.end());
+
+		for (u32 i = 0; i < nodes.size(); ++i)
+		{
+			for (auto &cpu : cpus)
+			{
+				if (std::find(nodes[i].second.begin(), nodes[i].second.end(), cpu.id) != nodes[i].second.end())
+					cpu.node = i;
+			}
+		}
+
+		std::stable_sort(cpus.begin(), cpus.end(), [](const CpuInfo &a, const CpuInfo &b)
+		{
+			return a.node < b.node;
+		});
+
+		// nodes with no usable cpus leave gaps, close them up
+		u32 dense = 0;
+
+		for (u32 i = 0; i < cpus.size(); ++i)
+		{
+			if (i > 0 && cpus[i].node != cpus[i - 1].node)
+				++dense;
+
+			cpus[i].node = dense;
+		}
+
+		return cpus;
+	}
+
+	u32 nodeCount(std::span<const CpuInfo> cpus)
+	{
+		return cpus.empty() ? 1 : cpus.back().node + 1;
+	}
+
+	bool pinCurrentThread(u32 cpu)
+	{
+		cpu_set_t set{};
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+
+		if (sched_setaffinity(0, sizeof(set), &set) != 0)
+		{
+			std::cerr << "failed to pin thread to cpu " << cpu << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "types.h"
+
+#include <vector>
+#include <span>
+
+namespace cpurt
+{
+	struct CpuInfo
+	{
+		u32 id;
+		// dense index, not necessarily the kernel's node number
+		u32 node;
+	};
+
+	// cpus this process is allowed to run on, sorted by numa node and then id.
+	// everything is on node 0 if the topology can't be read
+	[[nodiscard]] std::vector<CpuInfo> availableCpus();
+
+	// of cpus as returned by availableCpus (or the start of them)
+	[[nodiscard]] u32 nodeCount(std::span<const CpuInfo> cpus);
+
+	// restricts the calling thread to one cpu
+	bool pinCurrentThread(u32 cpu);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "types.h"
+
+#include <optional>
+#include <span>
+#include <cstring>
+
+#include "simd.h"
+#include "sampling.h"
+#include "rng.h"
+
+namespace cpurt
+{
+	// jsf32 run independently in every lane of a simd vector
+	template <typename U32s>
+	class BasicVecRng
+	{
+	public:
+		using F32s = typename simd::FloatVector<U32s>::Type;
+
+		static constexpr u32 Lanes = simd::Width<U32s>;
+
+		explicit BasicVecRng(std::optional<u32> seed = {})
+			: m_a{U32s{} + 0xF1EA5EED}
+		{
+			// lane seeds are drawn from a scalar generator so that
+			// every lane gets its own, unrelated stream
+			Rng seeder{seed};
+
+			for (u32 lane = 0; lane < Lanes; ++lane)
+			{
+				m_b[lane] = seeder.nextU32();
+			}
+
+			m_c = m_d = m_b;
+
+			for (i32 i = 0; i < 20; ++i)
+			{
+				(void)nextU32();
+			}
+		}
+
+		[[nodiscard]] inline U32s nextU32()
+		{
+			const auto e = m_a - simd::rotl<27>(m_b);
+			m_a = m_b ^ simd::rotl<17>(m_c);
+			m_b = m_c + m_d;
+			m_c = m_d + e;
+			m_d = e + m_a;
+			return m_d;
+		}
+
+		[[nodiscard]] inline F32s nextF32()
+		{
+			return simd::toF32(nextU32() >> 8) * 0x1.0p-24F;
+		}
+
+		inline void nextUnit(F32s &x, F32s &y, F32s &z)
+		{
+			const auto u = nextF32();
+			const auto v = nextF32();
+
+			sampling::uniformSphere(u, v, x, y, z);
+		}
+
+		inline void nextInUnitDisk(F32s &x, F32s &y)
+		{
+			const auto u = nextF32();
+			const auto v = nextF32();
+
+			sampling::concentricDisk(u, v, x, y);
+		}
+
+		void fillU32(std::span<u32> dst)
+		{
+			fill(dst, [this] { return nextU32(); });
+		}
+
+		void fillF32(std::span<f32> dst)
+		{
+			fill(dst, [this] { return nextF32(); });
+		}
+
+	private:
+		template <typename T, typename F>
+		inline void fill(std::span<T> dst, F &&next)
+		{
+			static_assert(sizeof(T) == sizeof(u32));
+
+			auto *ptr = dst.data();
+			const auto *end = ptr + dst.size();
+
+			for (; ptr + Lanes <= end; ptr += Lanes)
+			{
+				const auto v = next();
+				std::memcpy(ptr, &v, sizeof(v));
+			}
+
+			if (ptr != end)
+			{
+				const auto v = next();
+				std::memcpy(ptr, &v, (end - ptr) * sizeof(T));
+			}
+		}
+
+		U32s m_a, m_b, m_c, m_d;
+	};
+
+	using RngX8 = BasicVecRng<simd::u32x8>;
+	using RngX16 = BasicVecRng<simd::u32x16>;
+
+#ifdef __AVX512F__
+	using VecRng = RngX16;
+#else
+	using VecRng = RngX8;
+#endif
+}